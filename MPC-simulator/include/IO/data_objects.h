@@ -8,6 +8,8 @@
 #ifndef DATA_OBJECTS_H
 #define DATA_OBJECTS_H
 
+#include "model/SRTensor.h"
+
 #include <vector>
 #include <string>
 
@@ -30,22 +32,17 @@ private:
     std::vector<double> inits_; /** vector of initial values */
     std::vector<string> units_; /** vector of corresponding state units */
 
-    VectorXd** pp_SR_vec_; /** Matrix of Eigen::VectorXd holding every n_CV * n_MV step response */
+    SRTensorPtr SR_; /** Shared, read-only tensor holding every n_CV * n_MV step response */
     
      /**
-     * @brief Filling the dobbel linked VectorXd
+     * @brief Filling the step response tensor
      * 
+     * @param SR tensor to be filled
      * @param s_data Step response coefficients in JSON format
      * @param cv cv index
      * @param mv mv index
      */
-    void FillSR(const json& s_data, int cv, int mv);
-
-    /**
-     * @brief Helper function, allocating Eigen::VectorXd in constuctor
-     * 
-     */
-    void AllocateVectors();
+    void FillSR(SRTensor& SR, const json& s_data, int cv, int mv);
 
     /**
      * @brief Padding S coefficients such that the model representation has equal number of Ss for each response
@@ -62,7 +59,7 @@ public:
     CVData() : n_CV_{0}, n_MV_{0} {}
 
     /**
-     * @brief Constructor. Construct a new CVData object. Allocating memory for pp_SR_vec
+     * @brief Constructor. Construct a new CVData object. Allocating the shared step response tensor
      * 
      * @param cv_data nlohmann::json object holding state system data
      * @param n_MV number of maipulated variables
@@ -71,23 +68,28 @@ public:
      */
     CVData(const json& cv_data, int n_MV, int n_CV, int N);
 
+    void setInits(double value, int index) { inits_.at(index) = value; }
+
     /**
-     * @brief Destructor. Destroy the CVData object. Free memory of pp_SR_vec
+     * @brief Truncate the step responses at the latest settling index of all channels. 
+     * The settled tail is represented by S(N) of the truncated responses, hence folded into Psi of the FSRModel
+     * 
+     * @param tol relative tolerance, see SRTensor::getSettlingIndex
+     * @param min_N lower bound on the number of coefficients kept, e.g. P + 1
+     * @return int the chosen N
      */
-    ~CVData();
+    int TruncateSR(double tol, int min_N);
 
     /**
-     * @brief Operator assignment, performing deep copying
+     * @brief Resample the step responses to a coarser controller period, see SRTensor::Resample
      * 
-     * @param rhs right hand operator of type CVData
-     * @return CVData& 
+     * @param factor sample periods per controller period
+     * @return int the resampled N, ceil(N / factor)
      */
-    CVData& operator=(const CVData& rhs);
-
-    void setInits(double value, int index) { inits_.at(index) = value; }
+    int ResampleSR(int factor);
 
     // Get functions
-    VectorXd** getSR() const { return pp_SR_vec_; }
+    SRTensorPtr getSR() const { return SR_; }
     std::vector<string> getOutputs() const { return outputs_; }
     std::vector<double> getInits() const { return inits_; }
     std::vector<string> getUnits() const { return units_; }
@@ -130,6 +132,16 @@ struct MPCConfig {
     VectorXd RoH; /** Upper Slack variable tuning */
     VectorXd RoL; /** Lower Slack variable tuning */
     bool disable_slack;
+    double truncate_tol; /** Relative tolerance of step response truncation, 0 disables truncation */
+    int threads; /** Number of threads used to assemble the model matrices */
+    bool single_precision; /** Run the FSRModel in float instead of double, the QP is solved in double */
+    std::vector<int> blocking; /** Move blocking pattern, number of steps u is held constant in each block. Empty if every move is free */
+    int laguerre_order; /** Number of Laguerre functions parametrizing the moves of every MV, 0 if every move is free */
+    double laguerre_pole; /** Pole of the Laguerre network, 0 <= pole < 1 */
+    std::vector<int> coincidence_points; /** Ascending prediction steps in (W, P] of the tracking cost. Empty if every step is tracked */
+    std::vector<std::vector<int>> constraint_windows; /** [first, stride(, last)] Y constraint steps of every CV. Empty if every step is constrained */
+    int ss_order; /** Order of the ERA state space realization computing the free response, 0 uses Phi and Psi */
+    int resample; /** Sample periods of the step responses per controller period, 1 keeps the sample period */
 
     /**
      * @brief Empty Constructor. Construct a new MPCConfig object.
@@ -150,6 +162,29 @@ struct MPCConfig {
      * @param n_CV number of constrained variables
      */
     void DetermineSlack(const json& mpc_data, int n_CV); 
+
+    /**
+     * @brief Get the first step of every move block. Blocks starting beyond M are dropped, and the last block extends to M
+     * 
+     * @return std::vector<int> ascending block starts, [0, 1, ..., M-1] without blocking
+     */
+    std::vector<int> getBlockStarts() const;
+
+    /**
+     * @brief Check if the output of a CV is constrained at a prediction step, i.e. the step lies in the constraint window of the CV
+     * 
+     * @param cv index of the CV
+     * @param step prediction step, W < step <= P
+     * @return true if every step is constrained, or if step = first + i * stride <= last
+     */
+    bool isConstrainedStep(int cv, int step) const;
+
+    /**
+     * @brief Convert every setting counted in sample periods to controller periods of resample sample periods. 
+     * P, M, the blocks, the coincidence points and the constraint windows are rounded up, W is rounded down, 
+     * and the Laguerre pole is raised to the power of resample
+     */
+    void Resample();
 };
 
 #endif // DATA_OBJECTS_H
@@ -34,6 +34,18 @@ const string kQ = "Q";
 const string kR = "R";
 const string kRoH = "RoH";
 const string kRoL = "RoL";
+const string kTruncateTol = "truncate_tol";
+const string kThreads = "threads";
+const string kPrecision = "precision";
+const string kBlocking = "blocking";
+const string kLaguerreOrder = "laguerre_order";
+const string kLaguerrePole = "laguerre_pole";
+const string kCoincidencePoints = "coincidence_points";
+const string kConstraintWindows = "constraint_windows";
+const string kSSOrder = "ss_order";
+const string kResample = "resample";
+const string kFloat64 = "float64";
+const string kFloat32 = "float32";
 const string kC = "c"; 
 const string kDu = "du";
 
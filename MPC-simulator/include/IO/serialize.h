@@ -53,9 +53,10 @@ void WriteJson(const json& data, const string& filepath);
  * @param fsr The finite step response model
  * @param T MPC horizon
  */
+template <typename Scalar>
 void SerializeSimulationNew(const string& write_path, const string& scenario, const CVData& cvd, const MVData& mvd, 
                     const MatrixXd& y_pred, const MatrixXd& u_mat, const VectorXd& z_min, const VectorXd& z_max, 
-                    const MatrixXd& ref, const FSRModel& fsr, int T);    
+                    const MatrixXd& ref, const FSRModelT<Scalar>& fsr, int T);    
 
 /**
  * @brief Serialize a simulation by appending data on previous simulations
@@ -85,9 +86,10 @@ void SerializeSimulation(const string& write_path, const MatrixXd& y_pred, const
  * @param T MPC horizon
  * @return string JSON file
  */
+template <typename Scalar>
 string SerializeSimulation(const string& scenario, const CVData& cvd, const MVData& mvd, 
                     const MatrixXd& y_pred, const MatrixXd& u_mat, const VectorXd& z_min, const VectorXd& z_max,
-                    const MatrixXd& ref, const FSRModel& fsr, int T);
+                    const MatrixXd& ref, const FSRModelT<Scalar>& fsr, int T);
 
 /**
  * @brief Serializing an open loop simulation into simulation JSON data file
@@ -10,10 +10,16 @@
 #include "IO/data_objects.h"
 #include "model/FSRModel.h"
 
+#include <vector>
+
 #include <Eigen/Eigen>
 using VectorXd = Eigen::VectorXd;
 using MatrixXd = Eigen::MatrixXd;
 using SparseXd = Eigen::SparseMatrix<double>;
+using ChannelMap = SRTensor::ChannelMap;
+
+// The QP matrices are assembled once per run in double, the precision of OSQP. 
+// The k-dependant vectors are evaluated by the FSRModel in its own precision, Scalar, and widened to double.
 
 /**
  * @brief Set the One Matrix, slack scaling matric
@@ -26,7 +32,7 @@ using SparseXd = Eigen::SparseMatrix<double>;
 SparseXd setOneMatrix(int P, int W, int n_CV);
 
 /**
- * @brief Set the weight Matrices @param Q_bar and @param R_bar
+ * @brief Set the weight Matrices @param Q_bar and @param R_bar. With Laguerre functions R_bar penalizes du = L z in the Laguerre coordinates
  * 
  * @param Q_bar Output error penalty matrix
  * @param R_bar Actuation penalty matrix
@@ -35,32 +41,57 @@ SparseXd setOneMatrix(int P, int W, int n_CV);
 void setWeightMatrices(SparseXd& Q_bar, SparseXd& R_bar, const MPCConfig& conf);
 
 /**
- * @brief Set the Hessian Matrix G_cd
+ * @brief Set the Hessian Matrix G_cd. Q_bar is applied as a diagonal scaling, Theta^T Q_bar Theta is a multithreaded symmetric
+ * rank update of the channel blocks, and only the upper triangle, as read by OSQP, is assembled in CSC
  * 
  * @param Q_bar Positive definite Eigen::MatrixXd output tuning matrix
  * @param R_bar Positive definite Eigen::MatrixXd change of input tuning matrix
  * @param one scaling matrix
  * @param theta MatrixXd Theta matrix describing output predictions
+ * @param rows cost rows of Theta, the movable rows at the coincidence points, see FSRModel::getCostRows
+ * @param channels channel sparsity map, zero blocks of Theta are not multiplied, see FSRModel::getChannelMap
  * @param a dim(du)
  * @param n Number of optimalization variables
  * @param n_CV number of controlled variables
+ * @param threads number of threads computing the blocks of Theta^T Q_bar Theta
+ * @return SparseXd upper triangle of G_cd
+ */
+SparseXd setHessianMatrix(const SparseXd& Q_bar, const SparseXd& R_bar, const SparseXd& one, const MatrixXd& theta, 
+                            const std::vector<int>& rows, const ChannelMap& channels, int a, int n, int n_CV, int threads = 1); 
+
+/**
+ * @brief Gradient matrices, built once per run. The gradient of step k is q = gradient * (Lambda(k) - tau(k))(rows) + rho
  */
-SparseXd setHessianMatrix(const SparseXd& Q_bar, const SparseXd& R_bar, const SparseXd& one, const MatrixXd& theta, int a, int n, int n_CV); 
+struct GradientCache {
+    MatrixXd gradient; /** [4 Theta^T Q_bar; -2 1^T Q_bar; 2 1^T Q_bar], or 2 Theta^T Q_bar without slack, columns of the cost rows (n, n_q) */
+    std::vector<int> rows; /** Cost rows, the nonzero diagonal entries of Q_bar, n_q */
+    VectorXd rho; /** [0, RoH, RoL], or 0 without slack, n */
+    VectorXd difference; /** Lambda(k) - tau(k) at the cost rows, preallocated for setGradientVector, n_q */
+};
 
 /**
- * @brief Set the Gradient Vector @param q
+ * @brief Set the Gradient Cache. Theta^T Q_bar and 1^T Q_bar are precomputed in double, restricted to the cost rows
  * 
- * @param q Eigen::VectorXd gradient vector
- * @param fsr Finite step response model
  * @param Q_bar output tuning
  * @param one scaling matrix
+ * @param theta Theta matrix, (n_CV * (P-W), a)
+ * @param conf MPCConfig, RoH and RoL
+ * @return GradientCache 
+ */
+GradientCache setGradientCache(const SparseXd& Q_bar, const SparseXd& one, const MatrixXd& theta, const MPCConfig& conf);
+
+/**
+ * @brief Set the Gradient Vector @param q, one GEMV with the cached gradient matrix on preallocated storage. 
+ * Lambda is evaluated in the precision of the model, q is returned in double for OSQP
+ * 
+ * @param q Eigen::VectorXd gradient vector, n
+ * @param fsr Finite step response model
+ * @param cache gradient matrices, see setGradientCache and setGradientCacheWoSlack
  * @param ref Reference vector 
- * @param conf MPCconfig
- * @param n Number of optimalization variables
  * @param k MPC simulation step, concatinating y_ref
  */
-void setGradientVector(VectorXd& q, FSRModel& fsr, const SparseXd& Q_bar, const SparseXd& one,
-                        const MatrixXd& ref, const MPCConfig& conf, int n, int k);
+template <typename Scalar>
+void setGradientVector(VectorXd& q, FSRModelT<Scalar>& fsr, GradientCache& cache, const MatrixXd& ref, int k);
 
 /**
  * @brief Set the Constraint Vectors l, u. fsr model is k-dependant
@@ -70,12 +101,12 @@ void setGradientVector(VectorXd& q, FSRModel& fsr, const SparseXd& Q_bar, const
  * @param fsr Finite step response model
  * @param c_l Constant part of lower constraint
  * @param c_u Constant part of upper constraint
- * @param K_inv Inverse of actuation decomposition
  * @param Gamma Gamma vector
  * @param m Number of constraints
  * @param a dim(du)
  */
-void setConstraintVectors(VectorXd& l, VectorXd& u, FSRModel& fsr, const VectorXd& c_l, const VectorXd& c_u, const MatrixXd& K_inv,
+template <typename Scalar>
+void setConstraintVectors(VectorXd& l, VectorXd& u, FSRModelT<Scalar>& fsr, const VectorXd& c_l, const VectorXd& c_u, 
                          const SparseXd& Gamma, int m, int a);
 
 /**
@@ -83,14 +114,17 @@ void setConstraintVectors(VectorXd& l, VectorXd& u, FSRModel& fsr, const VectorX
  * 
  * @param one scaling matrix
  * @param theta FSRM step response predictions
- * @param K_inv Inverse of actuation decomposition
+ * @param basis Move basis, constrained moves du = basis * z, (d, a). See FSRModel::getMoveBasis
+ * @param rows constraint rows of Theta, Y constraints are only imposed on these rows, see FSRModel::getConstraintRows
  * @param m Number of constraints
  * @param n Number of optimization variables
  * @param a dim(du)
+ * @param n_MV number of manipulated variables
  * @param n_CV number of controlled variables
  * @return Eigen::Sparse<double>
  */
-SparseXd setConstraintMatrix(const SparseXd& one, const MatrixXd& theta, const MatrixXd& K_inv, int m, int n, int a, int n_CV);
+SparseXd setConstraintMatrix(const SparseXd& one, const MatrixXd& theta, const MatrixXd& basis, 
+                                const std::vector<int>& rows, int m, int n, int a, int n_MV, int n_CV);
 
 /**
  * @brief Define constant part of constraints, denoted c_l & c_u
@@ -104,12 +138,14 @@ SparseXd setConstraintMatrix(const SparseXd& one, const MatrixXd& theta, const M
 VectorXd ConfigureConstraint(const VectorXd& z_pop, int m, int a, bool upper);
 
 /**
- * @brief Calculate K inv matrix, this is a lower triangular matrix
+ * @brief Apply K inv to every column of x, u = K⁽⁻¹⁾ du. K⁽⁻¹⁾ is block diagonal with one lower triangular matrix of ones per MV,
+ * hence the product is a cumulative sum within the rows of every MV, O(rows) per column
  * 
- * @param a size of K_inv
+ * @param x moves, rows laid out per MV, (n_MV * moves, cols)
+ * @param n_MV number of manipulated variables
  * @return Eigen::MatrixXd
  */
-MatrixXd setKInv(int a);
+MatrixXd ApplyKInv(const MatrixXd& x, int n_MV);
 
 /**
  * @brief Set the Gamma object, to select the prior actuation. du_k = gamma * z
@@ -134,46 +170,49 @@ SparseXd setOmegaU(int M, int n_MV);
  * 
  * @param c Constrain vector data
  * @param conf MPC configuration
+ * @param rows constraint rows of Theta, Y constraints are only populated for these rows
  * @param a dim(du)
  * @param n_MV Number of manipulated variables
- * @param n_CV Number of constrained variables
  * @return VectorXd, populated vector
  */
-VectorXd PopulateConstraints(const VectorXd& c, const MPCConfig& conf, int a, int n_MV, int n_CV);
+VectorXd PopulateConstraints(const VectorXd& c, const MPCConfig& conf, const std::vector<int>& rows, int a, int n_MV);
 
 /**
- * @brief Set the Hessian Matrix G_cd object for condensed controller without slack
+ * @brief Set the Hessian Matrix G_cd object for condensed controller without slack, upper triangle in CSC, see setHessianMatrix
  * 
  * @param Q_bar Output error penalty matrix
  * @param R_bar Actuation penalty matrix
  * @param theta FSRM prediction matrix
- * @return SparseXd 
+ * @param rows cost rows of Theta, see FSRModel::getCostRows
+ * @param channels channel sparsity map, zero blocks of Theta are not multiplied
+ * @param threads number of threads computing the blocks of Theta^T Q_bar Theta
+ * @return SparseXd upper triangle of G_cd
  */
-SparseXd setHessianMatrixWoSlack(const SparseXd& Q_bar, const SparseXd& R_bar, const MatrixXd& theta);
+SparseXd setHessianMatrixWoSlack(const SparseXd& Q_bar, const SparseXd& R_bar, const MatrixXd& theta, const std::vector<int>& rows,
+                                    const ChannelMap& channels, int threads = 1);
 
 /**
- * @brief Set the Gradient Vector @param q object for condensed controller without slack
+ * @brief Set the Gradient Cache object for condensed controller without slack, q = 2 Theta^T Q_bar (Lambda(k) - tau(k))
  * 
- * @param q Eigen::VectorXd gradient vector
- * @param fsr Finite Step Response model
  * @param Q_bar Output error penalty matrix
- * @param ref Reference vector
- * @param n Number of optimization variables
- * @param k MPC simulation step, concatinating y_ref
+ * @param theta FSRM prediction matrix
+ * @return GradientCache 
  */
-void setGradientVectorWoSlack(VectorXd& q, FSRModel& fsr, const SparseXd& Q_bar, const MatrixXd& ref, int n, int k);
+GradientCache setGradientCacheWoSlack(const SparseXd& Q_bar, const MatrixXd& theta);
 
 /**
  * @brief Set the Constraint Matrix A object for condensed controller without slack
  * 
  * @param theta FSRM prediction matrix
- * @param K_inv Inverse of actuation decomposition
+ * @param basis Move basis, constrained moves du = basis * z, (d, n)
+ * @param rows constraint rows of Theta, Y constraints are only imposed on these rows, see FSRModel::getConstraintRows
  * @param m Number of constraints
  * @param n Number of optimization variables
- * @param n_CV Number of controlled variables
+ * @param n_MV Number of manipulated variables
  * @return SparseXd 
  */
-SparseXd setConstraintMatrixWoSlack(const MatrixXd& theta, const MatrixXd& K_inv, int m, int n, int n_CV);
+SparseXd setConstraintMatrixWoSlack(const MatrixXd& theta, const MatrixXd& basis, const std::vector<int>& rows, 
+                                    int m, int n, int n_MV);
 
 /**
  * @brief Set the Constraint Vectors l, u object for condensed controller without slack
@@ -183,11 +222,11 @@ SparseXd setConstraintMatrixWoSlack(const MatrixXd& theta, const MatrixXd& K_inv
  * @param fsr Finite step response model
  * @param c_l Constant part of lower constraint
  * @param c_u Constant part of upper constraint
- * @param K_inv Inverse of actuation decomposition
  * @param Gamma Gamma vector
  * @param m Number of constraints
  * @param n Number of optimization variables
  */
-void setConstraintVectorsWoSlack(VectorXd& l, VectorXd& u, FSRModel& fsr, const VectorXd& c_l, const VectorXd& c_u, const MatrixXd& K_inv,
+template <typename Scalar>
+void setConstraintVectorsWoSlack(VectorXd& l, VectorXd& u, FSRModelT<Scalar>& fsr, const VectorXd& c_l, const VectorXd& c_u, 
                          const SparseXd& Gamma, int m, int n);
 #endif // CONDENSED_QP_H
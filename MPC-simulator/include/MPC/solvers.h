@@ -18,6 +18,10 @@
 
 using VectorXd = Eigen::VectorXd;
 using MatrixXd = Eigen::MatrixXd;
+
+// The solvers are templated on the precision of the FSRModel, double or float, see MPCConfig::single_precision. 
+// OSQP solves in double, the optimized actuation is narrowed to Scalar when the model is propagated.
+
 /**
  * @brief Solving the condensed positive semi-definite optimalization problem using OSQP-Eigen for W = 0
  * 
@@ -30,7 +34,8 @@ using MatrixXd = Eigen::MatrixXd;
  * @param z_max upper constraint vector
  * @param ref Output reference data
  */
-void SRSolver(int T, MatrixXd& u_mat, MatrixXd& y_pred, FSRModel& fsr, const MPCConfig& conf, const VectorXd& z_min, 
+template <typename Scalar>
+void SRSolver(int T, MatrixXd& u_mat, MatrixXd& y_pred, FSRModelT<Scalar>& fsr, const MPCConfig& conf, const VectorXd& z_min, 
              const VectorXd& z_max, const MatrixXd& ref);
 
 /**
@@ -46,7 +51,8 @@ void SRSolver(int T, MatrixXd& u_mat, MatrixXd& y_pred, FSRModel& fsr, const MPC
  * @param z_max upper constraint vector
  * @param ref Output reference data
  */
-void SRSolver(int T, MatrixXd& u_mat, MatrixXd& y_pred, FSRModel& fsr_sim, FSRModel& fsr_cost, const MPCConfig& conf, const VectorXd& z_min, 
+template <typename Scalar>
+void SRSolver(int T, MatrixXd& u_mat, MatrixXd& y_pred, FSRModelT<Scalar>& fsr_sim, FSRModelT<Scalar>& fsr_cost, const MPCConfig& conf, const VectorXd& z_min, 
              const VectorXd& z_max, const MatrixXd& ref);
 
 /**
@@ -61,7 +67,8 @@ void SRSolver(int T, MatrixXd& u_mat, MatrixXd& y_pred, FSRModel& fsr_sim, FSRMo
  * @param z_max upper constraint vector
  * @param ref Output reference data
  */
-void SRSolverWoSlack(int T, MatrixXd& u_mat, MatrixXd& y_pred, FSRModel& fsr, const MPCConfig& conf, const VectorXd& z_min, 
+template <typename Scalar>
+void SRSolverWoSlack(int T, MatrixXd& u_mat, MatrixXd& y_pred, FSRModelT<Scalar>& fsr, const MPCConfig& conf, const VectorXd& z_min, 
              const VectorXd& z_max, const MatrixXd& ref);
 
 /**
@@ -77,7 +84,8 @@ void SRSolverWoSlack(int T, MatrixXd& u_mat, MatrixXd& y_pred, FSRModel& fsr, co
  * @param z_max upper constraint vector
  * @param ref Output reference data
  */
-void SRSolverWoSlack(int T, MatrixXd& u_mat, MatrixXd& y_pred, FSRModel& fsr_sim, FSRModel& fsr_cost, const MPCConfig& conf, const VectorXd& z_min, 
+template <typename Scalar>
+void SRSolverWoSlack(int T, MatrixXd& u_mat, MatrixXd& y_pred, FSRModelT<Scalar>& fsr_sim, FSRModelT<Scalar>& fsr_cost, const MPCConfig& conf, const VectorXd& z_min, 
              const VectorXd& z_max, const MatrixXd& ref);
 
 #endif // SOLVERS_H
\ No newline at end of file
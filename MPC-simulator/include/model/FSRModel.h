@@ -9,186 +9,335 @@
 #define FSR_MODEL_H
 
 #include "IO/data_objects.h"
+#include "model/SRTensor.h"
+#include "model/ThetaOperator.h"
+#include "model/FixedFSRKernel.h"
+#include "model/ThreadPool.h"
+#include "model/StateSpaceModel.h"
 
 #include <vector>
+#include <algorithm>
 #include <map>
 #include <string>
 using string = std::string;
 #include <iostream>
 
 #include <Eigen/Eigen>
+#include <unsupported/Eigen/CXX11/Tensor>
 using VectorXd = Eigen::VectorXd;
 using MatrixXd = Eigen::MatrixXd;
 using SparseXd = Eigen::SparseMatrix<double>;
+using Tensor3d = Eigen::Tensor<double, 3>;
+
+/**
+ * @brief Discrete orthonormal Laguerre functions of a pole a over the control horizon. 
+ * L(k+1) = A_l L(k), with L(0) = sqrt(1 - a^2) [1, -a, a^2, ..., (-a)^(order-1)]^T
+ * 
+ * @param M Control horizon
+ * @param order Number of Laguerre functions
+ * @param pole Laguerre pole, 0 <= a < 1. a = 0 gives the first order unit moves
+ * @return MatrixXd (M, order), row k being L(k)^T
+ */
+MatrixXd LaguerreBasis(int M, int order, double pole);
+
 /**
  * @brief A Finite Step Response model object. C++ class object holding the FSR model given a spesific format of the step response coefficients.
  * A MPC configuration is also passed as input in order shape the system matrices for the MPC algorithm. 
+ * 
+ * @tparam Scalar precision of the model matrices and the per step kernels, double or float. Instantiated in FSRModel.cc
  */ 
-class FSRModel {
+template <typename Scalar>
+class FSRModelT {
+public:
+    using VectorXs = Eigen::Matrix<Scalar, Eigen::Dynamic, 1>;
+    using MatrixXs = Eigen::Matrix<Scalar, Eigen::Dynamic, Eigen::Dynamic>;
+    using SparseXs = Eigen::SparseMatrix<Scalar>;
+    using Tensor3s = Eigen::Tensor<Scalar, 3>;
+    using TensorPtr = std::shared_ptr<const SRTensorT<Scalar>>;
+
 private:
     int n_CV_, n_MV_; /** Number of controlled and manipulated variables */
     int N_; /** Number of step response coefficients */
     int P_, M_, W_; /** Horizons */
+    int n_threads_; /** Number of threads used to assemble model matrices */
 
-    VectorXd u_, u_K_; /** Manipulated variables, U(k-N+W), n_MV */ /** Denotes U(k-1), n_MV */
-    VectorXd y_; /** Controlled variables n_CV * (P-W) */ 
-    VectorXd B_; /** Bias update, B(k), n_CV * (P - W)*/
-    MatrixXd du_tilde_mat_; /** Post change in actuation matrix (n_MV, (N-1-W)) */
+    VectorXs u_, u_K_; /** Manipulated variables, U(k-N+W), n_MV */ /** Denotes U(k-1), n_MV */
+    VectorXs y_; /** Controlled variables n_CV * (P-W) */ 
+    VectorXs B_; /** Bias update, B(k), n_CV * (P - W)*/
+    VectorXs lambda_; /** Free response, Phi * Delta U_tilde + Psi * U, n_CV * (P - W) */
+    MatrixXs du_tilde_mat_; /** Post change in actuation ring buffer (n_MV, (N-1-W)) */
+    int head_; /** Column of du_tilde_mat_ holding the most recent actuation, du(k-1) */
 
-    VectorXd** pp_SR_vec_; /** Matrix of Eigen::VectorXd holding every n_CV * n_MV step response */
-    MatrixXd** pp_SR_mat_; /** Tensor of Eigen::MatrixXd representing the SISO prediction (P,M) times (n_CV, n_MV) */
-
-    // Model matrices: 
-    MatrixXd theta_; /** Matrix of all SISO predictions (n_CV*(P-W), n_MV*M) */
-    MatrixXd phi_; /** Past step coefficients (n_CV*(P-W), sum N_CV {(N-W-1)}) */
-    MatrixXd psi_; /** Last step coefficient matrix, (n_CV*(P-W), n_MV)*/
+    TensorPtr SR_; /** Shared, read-only tensor holding every n_CV * n_MV step response */
 
     /**
-     * @brief Helper function allocating and performing deep copy of Eigen::VectorXd** 
-     * 
-     * @param SR Dobble pointer Eigen::VectorXd**
+     * @brief Model matrices, built once by the constructor and read-only afterwards. 
+     * Shared by every copy of the model, see fork
      */
-    void AllocateAndDeepCopy(VectorXd** SR);
+    struct ModelMatrices {
+        MatrixXs theta; /** Matrix of all SISO predictions (n_CV*(P-W), n_MV*M), dense including the dead time rows */
+        ThetaOperatorT<Scalar> theta_op; /** Structured Theta, applying Theta by convolution */
+        MatrixXs psi; /** Last step coefficient matrix, (n_CV*(P-W), n_MV)*/
+        std::shared_ptr<const FSRKernel<Scalar>> kernel; /** Fixed-size kernels if a specialization exists for the dimensions, else nullptr */
+        std::vector<int> movable_rows; /** Rows of Theta that are not structurally zero, i.e. predictions du can move */
+        std::vector<int> block_starts; /** First step of every move block, u is held constant within a block */
+        MatrixXs basis; /** Laguerre functions of every MV, du = basis * z, (n_MV*M, n_MV*order). Empty if not configured */
+        std::vector<int> cost_rows; /** Movable rows at the coincidence points, the Y rows of the tracking cost */
+        std::vector<int> constraint_rows; /** Movable rows in the constraint windows, the Y rows of the constraints */
+    };
+    std::shared_ptr<const ModelMatrices> mat_; /** Shared, read-only model matrices */
+    VectorXs tail_; /** Free response one step beyond the horizon, n_CV, preallocated for UpdateU */
+    std::shared_ptr<const StateSpaceModel> ss_; /** Realization computing the free response by state recursion, nullptr for Phi */
+    MatrixXs ss_A_, ss_B_, ss_C_; /** Matrices of ss_ in the precision of the model */
+    MatrixXs ss_D_; /** Static correction S(N) - C (I - A)^-1 B of the settled input u_, (n_CV, n_MV) */
+    VectorXs x_; /** State of the realization, x(k), n_x */
 
     /**
-     * @brief Set pp_SR_mat, by generating SISO predictions from pp_SR_vec
-     */
-    void setSRMatrix();
-    
-    /**
-     * @brief Set lower triangular matrix based on the prediction vector
+     * @brief Set lower triangular SISO prediction block, sliced from prediction W
      * 
-     * @param pred_vec prediction vector 
-     * @param S Eigen::MatrixXd to be filled with lower triangular SISO predictions
+     * @param pred_vec canonical prediction vector 
+     * @param scale gain of the channel relative to pred_vec
+     * @param S Block of Theta to be filled with lower triangular SISO predictions, (P-W, M)
+     * @param W Start horizon
      */
-    void setLowerTriangularMatrix(const VectorXd& pred_vec, MatrixXd& S);
-    
+    void setLowerTriangularMatrix(const typename SRTensorT<Scalar>::ConstChannel& pred_vec, Scalar scale, Eigen::Ref<MatrixXs> S, int W) const;
+
     /**
-     * @brief Set the Theta Matrix object. By filling the matrix with SISO preductions from pp_SR_mat
+     * @brief Set the Theta Matrix object. By filling the matrix with SISO preductions from SR_
      * If W_ is not equation to 0, the FSRM needs to declare simulation matrices. 
      * Implementing equation ... Light-weight MPC master thesis
      * 
      * @param W Start horizon
+     * @param pool thread pool, one channel per task
      * 
-     * @return MatrixXd
+     * @return MatrixXs
      */
-    MatrixXd getThetaMatrix(int W);
+    MatrixXs getThetaMatrix(int W, ThreadPool& pool) const;
 
     /**
      * @brief Set the Phi Matrix object holding the previous step coefficients
      * Implementing equation ... Light-weight MPC master thesis
      * 
      * @param W Start horizon
-     * @return MatrixXd
+     * @param pool thread pool, one channel per task
+     * @return MatrixXs
      */
-    MatrixXd getPhiMatrix(int W);
+    MatrixXs getPhiMatrix(int W, ThreadPool& pool) const;
 
     /**
-     * @brief Pad the vector, by appending Sn (last element of vec) pad times
+     * @brief Matrix-free Phi * Delta U_tilde. Every row of Phi is a shifted window of the step response padded with S(N),
+     * hence the product is a correlation with the past actuations plus S(N) times a suffix sum of the past actuations
      * 
-     * @param vec Eigen::VectorXd to be padded
-     * @param pad Number of pads
-     * @param sn Last S-coefficient
-     * @return Eigen::VectorXd Padded vector 
+     * @return VectorXs n_CV * (P-W)
      */
-    VectorXd PadVec(VectorXd& vec, int pad, double sn);
+    VectorXs ApplyPhi() const;
 
     /**
      * @brief Set the Psi
      * Implementing equation ... Light-weight MPC master thesis
      * 
      * @param W Start horizon
-     * @return MatrixXd
+     * @param pool thread pool, one cv per task
+     * @return MatrixXs
      */
-    MatrixXd getPsi(int W);
+    MatrixXs getPsi(int W, ThreadPool& pool) const;
 
     /**
      * @brief Get the Du Tilde object, past actuations, by flattening du_tilde_mat
      * 
-     * @return VectorXd 
+     * @return VectorXs 
+     */
+    VectorXs getDuTilde() const;
+
+    /**
+     * @brief Map a logical history column, 0 being the most recent actuation, to its column in the ring buffer
+     * 
+     * @param lag logical column
+     * @return int column in du_tilde_mat_
      */
-    VectorXd getDuTilde() const;
+    int RingIndex(int lag) const { return (head_ + lag) % (N_-W_-1); }
+
+    /**
+     * @brief Evaluate the free response by the full product, Phi * Delta U_tilde + Psi * U. 
+     * Used to initialize lambda_ and to validate the incremental update in debug builds
+     * 
+     * @return VectorXs 
+     */
+    VectorXs getFreeResponse() const { return ApplyPhi() + mat_->psi * u_; }
+
+    /**
+     * @brief Get the free response one step beyond the stored prediction rows, used when shifting lambda_
+     * 
+     * @param cv cv index
+     * @return Scalar free response of cv at prediction P
+     */
+    Scalar getFreeResponseTail(int cv) const;
+
+    /**
+     * @brief Reset x_ from the settled input u_ and the actuations of the ring buffer, oldest first
+     */
+    void ResetState();
+
+    /**
+     * @brief Evaluate the free response by state recursion, C x(k+p) with u held at U(k-1), p = W, ..., P-1. O(P * n_x^2).
+     * The settled input u_ is charged at S(N) like Psi, by adding (S(N) - C (I - A)^-1 B) u_ to every prediction
+     * 
+     * @return VectorXs n_CV * (P-W)
+     */
+    VectorXs getStateFreeResponse() const;
+
+    /**
+     * @brief Set the movable rows. Row p of CV i is movable if p >= min_mv(d_i,mv) - W, d being the dead time of the channel
+     * 
+     * @return std::vector<int> ascending row indices of Theta
+     */
+    std::vector<int> setMovableRows() const;
 
     /**
      * @brief Get the Omega Y object
      * 
-     * @return SparseXd Omega Y matrix
+     * @return SparseXs Omega Y matrix
      */
-    SparseXd getOmegaY() const;
+    SparseXs getOmegaY() const;
 
     /**
      * @brief Set the Init Y object
      * 
      * @param init_y vector of init values
      * @param predictions P - W
-     * @return VectorXd 
+     * @return VectorXs 
      */
-    VectorXd setInitY(std::vector<double> init_y, int predictions);
+    VectorXs setInitY(std::vector<double> init_y, int predictions);
     
 public: 
     /**
      * @brief Default construcor
      * 
      */
-    FSRModel() : n_CV_{0}, n_MV_{0} {}
+    FSRModelT() : n_CV_{0}, n_MV_{0}, n_threads_{1}, head_{0}, mat_{std::make_shared<ModelMatrices>()} {}
     
     /**
      * @brief FSRModel constructor
      * 
-     * @param SR step coefficient matric
+     * @param SR shared step coefficient tensor
      * @param m_param model parameters
      * @param conf MPC configuration
      * @param init_u initial actuation
      * @param init_y initial output
      */
-    FSRModel(VectorXd** SR, std::map<string, int> m_param, const MPCConfig& conf,
+    FSRModelT(TensorPtr SR, std::map<string, int> m_param, const MPCConfig& conf,
             const std::vector<double>& init_u, const std::vector<double>& init_y);
 
     /**
      * @brief Construct a new FSRModel object, Open loop constructor
      * 
-     * @param SR step coefficient matric
+     * @param SR shared step coefficient tensor
      * @param m_param model parameters
      * @param init_u initial actuation
      * @param init_y initial output
      */
-    FSRModel(VectorXd** SR, std::map<std::string, int> m_param,
+    FSRModelT(TensorPtr SR, std::map<std::string, int> m_param,
             const std::vector<double>& init_u, const std::vector<double>& init_y);
     /**
-     * @brief The destructor. Freeing the memory allocated in the constructor
+     * @brief Fork the model at its current state, e.g. to predict a changed reference from a live controller. 
+     * The fork shares the step responses and the model matrices with this model, and copies the actuation history, 
+     * the bias and the free response, O(n_MV * N + n_CV * P). Stepping either model does not affect the other. 
+     * The shared matrices are never mutated, hence forks can be stepped concurrently on separate threads
+     * 
+     * @return FSRModelT independent model sharing the read-only matrices
      */
-    ~FSRModel();
+    FSRModelT fork() const { return *this; }
 
     /**
-     * @brief Set the Du Tilde Mat object
+     * @brief Set the Du Tilde Mat object, column 0 being the most recent actuation. Resets the ring buffer
      * 
-     * @param mat 
+     * @param mat past actuations, as parsed
      */
     void setDuTildeMat(const MatrixXd& mat);
 
+    /**
+     * @brief Compute the free response by state recursion of a realization of the step responses, instead of Phi and Psi. 
+     * The state is reset from the current actuation history. The ring buffer is still kept for getDuTildeMat
+     * 
+     * @param ss state space realization, see RealizeERA. nullptr restores the FSR free response
+     */
+    void setStateSpace(std::shared_ptr<const StateSpaceModel> ss);
+    bool isStateSpace() const { return ss_ != nullptr; }
+
+    /**
+     * @brief Get the Du Tilde Mat object, unrolling the ring buffer such that column 0 is the most recent actuation
+     * 
+     * @return MatrixXd (n_MV, (N-1-W)), as serialized
+     */
+    MatrixXd getDuTildeMat() const;
+
     /** Get functions */
     int getP() const { return P_; }
     int getM() const { return M_; }
     int getW() const { return W_; }
     int getN_CV() const { return n_CV_; }
     int getN_MV() const { return n_MV_; }
-    MatrixXd getDuTildeMat() const { return du_tilde_mat_; }
-    VectorXd getUK() const { return u_K_; }
+    VectorXs getUK() const { return u_K_; }
+    bool isFixedSize() const { return mat_->kernel != nullptr; }
+    ThetaKernel getThetaKernel() const { return mat_->theta_op.getKernel(); } /** Kernel of the Theta operator, unused if isFixedSize */
+    const std::vector<int>& getMovableRows() const { return mat_->movable_rows; }
+    const std::vector<int>& getCostRows() const { return mat_->cost_rows; }
+    const std::vector<int>& getConstraintRows() const { return mat_->constraint_rows; }
+    const typename SRTensorT<Scalar>::ChannelMap& getChannelMap() const { return SR_->getChannelMap(); }
+    /** Decision moves per MV, n_b <= M blocks or the Laguerre order */
+    int getNumMoves() const { return mat_->basis.size() ? int(mat_->basis.cols()) / n_MV_ : int(mat_->block_starts.size()); } 
+    bool isBlocked() const { return mat_->basis.size() || getNumMoves() < M_; } /** True if z is not the full move sequence */
+
+    /**
+     * @brief Get the move basis, mapping the decision moves to the constrained moves, du = basis * z. 
+     * The Laguerre functions if configured, else identity since blocked moves are constrained at the block starts
+     * 
+     * @return MatrixXs (n_MV*M, n_MV*order) or (n_MV*n_b, n_MV*n_b)
+     */
+    MatrixXs getMoveBasis() const { 
+        return mat_->basis.size() ? mat_->basis : MatrixXs::Identity(n_MV_ * getNumMoves(), n_MV_ * getNumMoves()); 
+    }
+
+    /**
+     * @brief Expand the decision moves to the full move sequence. Move b of an MV is applied at the start of block b, 
+     * and u is held constant for the rest of the block. With Laguerre functions, du = basis * z
+     * 
+     * @param z dim(z) = n_MV * n_b
+     * @return Eigen::Matrix<T, Eigen::Dynamic, 1> n_MV * M
+     */
+    template <typename T>
+    Eigen::Matrix<T, Eigen::Dynamic, 1> ExpandMoves(const Eigen::Matrix<T, Eigen::Dynamic, 1>& z) const {
+        if (!isBlocked()) {
+            return z;
+        }
+        if (mat_->basis.size()) {
+            return mat_->basis.template cast<T>() * z;
+        }
+        const int n_b = getNumMoves();
+        Eigen::Matrix<T, Eigen::Dynamic, 1> du = Eigen::Matrix<T, Eigen::Dynamic, 1>::Zero(n_MV_ * M_);
+        for (int j = 0; j < n_MV_; j++) {
+            for (int b = 0; b < n_b; b++) {
+                du(j * M_ + mat_->block_starts[b]) = z(j * n_b + b);
+            }
+        }
+        return du;
+    }
 
     /** MPC functionality*/
     /**
-     * @brief Projecting the FSRModel, by updating the former step responses and actuation
+     * @brief Projecting the FSRModel, by updating the former step responses and actuation. 
+     * The free response is shifted one step and the contribution of du is added, O(n_CV * n_MV * N)
      * 
      * @param du Optimized actuation for next projection, du = omega_u * du
      */
-    void UpdateU(const VectorXd& du);
+    void UpdateU(const VectorXs& du);
 
     /**
      * @brief Set the Bias object
      * 
      * @param bias Bias argument
      */
-    void setBias(const VectorXd& bias) {
+    void setBias(const VectorXs& bias) {
         for (int i = 0; i < n_CV_; i++) {
             B_.block((P_-W_) * i, 0, (P_ - W_), 0) = bias;
         }
@@ -199,31 +348,72 @@ public:
      *                                    = Omega * (Theta * Delta U + Lambda)
      * Y is a vector containing every (P-W) * n_CV predictions further in time
      * 
-     * @param du [Eigen::VectorXd] dim(du) = a = n_MV * M
+     * @param du [Eigen::VectorXs] dim(du) = a = n_MV * n_b, the blocked moves
      * @param all_pred boolean, if true return P predictions, if false return k+1
-     * @return VectorXd predicted output, one step, k+1 ahead. 
+     * @return VectorXs predicted output, one step, k+1 ahead. 
      */
-    MatrixXd getY(const VectorXd& du, bool all_pred = false) {
+    MatrixXs getY(const VectorXs& du, bool all_pred = false) {
         if (all_pred) { // Get all P predictions
-            return (theta_ * du + getLambda()).reshaped<Eigen::RowMajor>(n_CV_, P_);
+            return (ApplyTheta(du) + getLambda()).template reshaped<Eigen::RowMajor>(n_CV_, P_);
         } else { // Get next prediction
-            return getOmegaY() * (theta_ * du + getLambda());
+            return getOmegaY() * (ApplyTheta(du) + getLambda());
         }
     } 
 
     /**
-     * @brief Get the Theta object
+     * @brief Predict the output of K candidate actuation sequences from the current state.
+     * Lambda is evaluated once and every candidate is predicted by a single product Theta * candidate_moves
      * 
-     * @return MatrixXd 
+     * @param candidate_moves (n_MV * n_b, K), column k being the blocked moves of sequence k
+     * @return Tensor3s (n_CV, P-W, K), element (cv, p, k) being the prediction of cv at step W+p+1 for candidate k
      */
-    MatrixXd getTheta() const { return theta_; }
+    Tensor3s PredictBatch(const MatrixXs& candidate_moves) const;
+
+    /**
+     * @brief Get the Theta object, restricted to the block start columns if the moves are blocked
+     * 
+     * @return MatrixXs (n_CV*(P-W), n_MV*n_b)
+     */
+    MatrixXs getTheta() const { return mat_->theta; }
+
+    /**
+     * @brief Theta * du, using the structured Theta operator on the expanded moves
+     * 
+     * @param du dim(du) = n_MV * n_b
+     * @return VectorXs n_CV * (P-W)
+     */
+    VectorXs ApplyTheta(const VectorXs& du) const { 
+        return mat_->kernel ? mat_->kernel->ApplyTheta(du) : mat_->theta_op.Apply(ExpandMoves(du)); 
+    }
+
+    /**
+     * @brief Get the Phi object. Phi is not stored by the model, the dense matrix is built on request
+     * 
+     * @return MatrixXs (n_CV*(P-W), n_MV*(N-W-1))
+     */
+    MatrixXs getPhi() const { 
+        ThreadPool pool(n_threads_);
+        return getPhiMatrix(W_, pool); 
+    }
 
     /**
      * @brief Get the Lambda object, Lambda = Phi * Delta U_tilde + Psi * U + y_0
+     * The free response is held as state and updated incrementally in UpdateU
      * 
-     * @return VectorXd 
+     * @return VectorXs 
      */
-    VectorXd getLambda() const { return phi_ * getDuTilde() + psi_ * u_ + y_ + B_; }; 
+    VectorXs getLambda() const { return lambda_ + y_ + B_; }; 
+
+    /**
+     * @brief Get one row of Lambda without forming the vector
+     * 
+     * @param row row of Lambda, cv * (P-W) + p
+     * @return Scalar 
+     */
+    Scalar getLambda(int row) const { return lambda_(row) + y_(row) + B_(row); }
 };
 
+using FSRModel = FSRModelT<double>;
+using FSRModelF = FSRModelT<float>;
+
 #endif // FSR_MODEL_H
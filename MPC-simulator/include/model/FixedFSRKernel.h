@@ -0,0 +1,121 @@
+/**
+ * @file FixedFSRKernel.h
+ * @author Geir Ola Tvinnereim
+ * @copyright  Released under the terms of the BSD 3-Clause License
+ * @date 2023
+ */
+
+#ifndef FIXED_FSR_KERNEL_H
+#define FIXED_FSR_KERNEL_H
+
+#include "model/SRTensor.h"
+
+#include <memory>
+
+#include <Eigen/Dense>
+using VectorXd = Eigen::VectorXd;
+using MatrixXd = Eigen::MatrixXd;
+
+/**
+ * @brief Per step kernels of the FSRModel, the free response update and the Theta products.
+ * Implemented by FixedFSRKernel for dimensions known at compile time.
+ * 
+ * @tparam Scalar coefficient type
+ */
+template <typename Scalar>
+class FSRKernel {
+public:
+    using VectorXs = Eigen::Matrix<Scalar, Eigen::Dynamic, 1>;
+
+    virtual ~FSRKernel() = default;
+
+    /**
+     * @brief Shift the free response one step and add the contribution of du,
+     * Lambda(k+1)[p] = Lambda(k)[p+1] + sum_mv S(p) du, where Lambda(k)[P] = tail
+     *
+     * @param lambda free response, n_CV * P
+     * @param du actuation, n_MV
+     * @param tail free response one step beyond the horizon, n_CV
+     */
+    virtual void ShiftLambda(Eigen::Ref<VectorXs> lambda, const VectorXs& du, const VectorXs& tail) const = 0;
+
+    /**
+     * @brief Theta * du
+     *
+     * @param du dim(du) = n_MV * M
+     * @return VectorXs n_CV * P
+     */
+    virtual VectorXs ApplyTheta(const VectorXs& du) const = 0;
+};
+
+/**
+ * @brief FSRModel kernels with fixed-size Eigen types, such that the products are unrolled and vectorized at compile time.
+ * Only defined for W = 0.
+ *
+ * @tparam Scalar coefficient type
+ * @tparam nCV number of controlled variables
+ * @tparam nMV number of manipulated variables
+ * @tparam P prediction horizon
+ * @tparam M control horizon
+ */
+template <typename Scalar, int nCV, int nMV, int P, int M>
+class FixedFSRKernel : public FSRKernel<Scalar> {
+private:
+    using VectorXs = typename FSRKernel<Scalar>::VectorXs;
+    using MatrixXs = Eigen::Matrix<Scalar, Eigen::Dynamic, Eigen::Dynamic>;
+    using Lambda = Eigen::Matrix<Scalar, nCV * P, 1>;
+    using Du = Eigen::Matrix<Scalar, nMV, 1>;
+    using DU = Eigen::Matrix<Scalar, nMV * M, 1>;
+
+    Eigen::Matrix<Scalar, nCV * P, nMV * M> theta_; /** Theta, (n_CV*P, n_MV*M) */
+    Eigen::Matrix<Scalar, nCV * P, nMV> s_; /** First P step coefficients of every channel, (n_CV*P, n_MV) */
+
+public:
+    EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+
+    /**
+     * @brief Construct a new fixed-size kernel
+     *
+     * @param SR shared step coefficient tensor
+     * @param theta dense Theta, (n_CV*P, n_MV*M)
+     */
+    FixedFSRKernel(const SRTensorT<Scalar>& SR, const MatrixXs& theta) : theta_{theta} {
+        for (int i = 0; i < nCV; i++) {
+            for (int j = 0; j < nMV; j++) {
+                s_.col(j).template segment<P>(i * P) = SR.getChannel(i, j).template head<P>();
+            }
+        }
+    }
+
+    void ShiftLambda(Eigen::Ref<VectorXs> lambda, const VectorXs& du, const VectorXs& tail) const override {
+        Eigen::Map<Lambda> lam(lambda.data());
+        for (int i = 0; i < nCV; i++) {
+            for (int p = 0; p < P - 1; p++) {
+                lam(i * P + p) = lam(i * P + p + 1);
+            }
+            lam(i * P + P - 1) = tail(i);
+        }
+        lam.noalias() += s_ * Eigen::Map<const Du>(du.data());
+    }
+
+    VectorXs ApplyTheta(const VectorXs& du) const override {
+        return theta_ * Eigen::Map<const DU>(du.data());
+    }
+};
+
+/**
+ * @brief Pick a fixed-size kernel for the model dimensions.
+ * Specializations exist for SISO and 2x2 systems with short horizons, see FixedFSRKernel.cc
+ *
+ * @param SR shared step coefficient tensor
+ * @param theta dense Theta
+ * @param P prediction horizon
+ * @param M control horizon
+ * @param W start horizon
+ * @return std::shared_ptr<const FSRKernel<Scalar>> nullptr if no specialization exists, the dynamic path is then used
+ */
+template <typename Scalar>
+std::shared_ptr<const FSRKernel<Scalar>> MakeFixedKernel(const SRTensorT<Scalar>& SR, 
+                    const Eigen::Matrix<Scalar, Eigen::Dynamic, Eigen::Dynamic>& theta, int P, int M, int W);
+
+#endif // FIXED_FSR_KERNEL_H
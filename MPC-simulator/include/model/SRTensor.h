@@ -0,0 +1,213 @@
+/**
+ * @file SRTensor.h
+ * @author Geir Ola Tvinnereim
+ * @copyright  Released under the terms of the BSD 3-Clause License
+ * @date 2023
+ */
+
+#ifndef SR_TENSOR_H
+#define SR_TENSOR_H
+
+#include <memory>
+#include <vector>
+#include <utility>
+#include <type_traits>
+
+#include <Eigen/Dense>
+using VectorXd = Eigen::VectorXd;
+
+/**
+ * @brief Step response coefficients of every (CV, MV) channel stored in one contiguous, aligned buffer.
+ * Every stored vector starts on an aligned address, the leading dimension is N padded up to the alignment.
+ * After Deduplicate, channels that are identical up to a scalar gain share one canonical vector, S_cv,mv = scale * canonical.
+ * 
+ * @tparam Scalar coefficient type, double or float. Instantiated in SRTensor.cc
+ */
+template <typename Scalar>
+class SRTensorT {
+public:
+    using VectorXs = Eigen::Matrix<Scalar, Eigen::Dynamic, 1>;
+    using Channel = Eigen::Map<VectorXs, Eigen::AlignedMax>;
+    using ConstChannel = Eigen::Map<const VectorXs, Eigen::AlignedMax>;
+    using ScaledChannel = decltype(std::declval<Scalar>() * std::declval<ConstChannel>());
+    using ChannelMap = Eigen::Array<bool, Eigen::Dynamic, Eigen::Dynamic>;
+
+private:
+    template <typename> friend class SRTensorT;
+
+    int n_CV_, n_MV_; /** Number of controlled and manipulated variables */
+    int N_; /** Number of step response coefficients */
+    int stride_; /** Leading dimension, N padded to alignment */
+    VectorXs data_; /** Canonical coefficient vectors, n_canonical * stride */
+    std::vector<int> canonical_; /** Canonical vector of each channel, index cv * n_MV + mv */
+    std::vector<Scalar> scale_; /** Gain of each channel relative to its canonical vector, index cv * n_MV + mv */
+    ChannelMap nonzero_; /** Channel sparsity map (n_CV, n_MV), false if every coefficient of the channel is zero */
+    bool deduplicated_; /** True when channels share canonical vectors, the coefficients are then read-only */
+
+    /**
+     * @brief Offset of the first coefficient of a canonical vector
+     * 
+     * @param canonical canonical index
+     * @return Eigen::Index
+     */
+    Eigen::Index Offset(int canonical) const { return Eigen::Index(canonical) * stride_; }
+
+public:
+    /**
+     * @brief Empty constructor
+     */
+    SRTensorT() : n_CV_{0}, n_MV_{0}, N_{0}, stride_{0}, deduplicated_{false} {}
+
+    /**
+     * @brief Construct a zero initialized tensor, one canonical vector per channel. 
+     * Every channel is marked nonzero until UpdateChannelMap is called
+     *
+     * @param n_CV number of controlled variables
+     * @param n_MV number of manipulated variables
+     * @param N number of step coefficients
+     */
+    SRTensorT(int n_CV, int n_MV, int N);
+
+    /** Get functions */
+    int getN_CV() const { return n_CV_; }
+    int getN_MV() const { return n_MV_; }
+    int getN() const { return N_; }
+    int getNumCanonical() const { return int(data_.size() / std::max(stride_, 1)); }
+    const ChannelMap& getChannelMap() const { return nonzero_; }
+    bool isNonzero(int cv, int mv) const { return nonzero_(cv, mv); }
+
+    /**
+     * @brief Detect all-zero channels, called when the coefficients are filled
+     */
+    void UpdateChannelMap();
+
+    /**
+     * @brief Let channels that are identical up to a scalar gain share one canonical vector, and release the duplicates. 
+     * Channel k is a duplicate of canonical c if ||S_k - scale * c|| <= tol * ||S_k||
+     * 
+     * @param tol relative tolerance
+     */
+    void Deduplicate(double tol = 1e-12);
+
+    /**
+     * @brief Get the writable step response of a channel, [S(1), ..., S(N)]. Only valid before Deduplicate
+     *
+     * @param cv cv index
+     * @param mv mv index
+     * @return Channel view of N coefficients
+     */
+    Channel getChannel(int cv, int mv);
+
+    /**
+     * @brief Get the step response of a channel, scale * canonical
+     *
+     * @param cv cv index
+     * @param mv mv index
+     * @return ScaledChannel expression of N coefficients
+     */
+    ScaledChannel getChannel(int cv, int mv) const { return getScale(cv, mv) * getCanonical(cv, mv); }
+
+    /**
+     * @brief Get the canonical vector of a channel. Kernels apply the channel gain, getScale, once per product
+     *
+     * @param cv cv index
+     * @param mv mv index
+     * @return ConstChannel view of N coefficients
+     */
+    ConstChannel getCanonical(int cv, int mv) const { 
+        return ConstChannel(data_.data() + Offset(getCanonicalIndex(cv, mv)), N_); 
+    }
+
+    int getCanonicalIndex(int cv, int mv) const { return canonical_[cv * n_MV_ + mv]; }
+    Scalar getScale(int cv, int mv) const { return scale_[cv * n_MV_ + mv]; }
+
+    /**
+     * @brief Get coefficient k of every MV channel of a CV, [S_cv,1(k), ..., S_cv,n_MV(k)]
+     *
+     * @param cv cv index
+     * @param k coefficient index
+     * @return VectorXs n_MV coefficients
+     */
+    VectorXs getCoefficients(int cv, int k) const;
+
+    /**
+     * @brief Get a single coefficient
+     *
+     * @param cv cv index
+     * @param mv mv index
+     * @param k coefficient index
+     * @return Scalar S_cv,mv(k)
+     */
+    Scalar operator()(int cv, int mv, int k) const { return getScale(cv, mv) * data_(Offset(getCanonicalIndex(cv, mv)) + k); }
+
+    /**
+     * @brief Get the dead time of a channel, the number of leading coefficients with |S(k)| <= tol * max|S|
+     * 
+     * @param cv cv index
+     * @param mv mv index
+     * @param tol relative tolerance
+     * @return int dead time, N if the channel is zero
+     */
+    int getDeadTime(int cv, int mv, double tol) const;
+
+    /**
+     * @brief Get the settling index of a channel, the first k such that |S(j) - S(N)| <= tol * max|S| for every j >= k
+     * 
+     * @param cv cv index
+     * @param mv mv index
+     * @param tol relative tolerance
+     * @return int settling index, 0 <= k <= N-1
+     */
+    int getSettlingIndex(int cv, int mv, double tol) const;
+
+    /**
+     * @brief Copy the first N coefficients of every canonical vector into a new tensor, keeping the channel sharing. 
+     * Coefficients beyond N are represented by S(N) of the truncated tensor
+     * 
+     * @param N number of step coefficients kept, 1 <= N <= getN()
+     * @return SRTensorPtr truncated tensor
+     */
+    std::shared_ptr<const SRTensorT> Truncate(int N) const;
+
+    /**
+     * @brief Resample the step responses to a controller period of factor sample periods, S_c(k) = S(k * factor).
+     * A move held over one coarse period is a move at its first fine period under zero-order hold, hence the step
+     * response is sampled, not averaged. The last coefficient is S(N), so the steady-state gains are kept
+     * 
+     * @param factor sample periods per controller period, factor >= 1
+     * @return SRTensorPtr tensor of ceil(N / factor) coefficients, keeping the channel sharing
+     */
+    std::shared_ptr<const SRTensorT> Resample(int factor) const;
+
+    /**
+     * @brief Copy the tensor in another precision, keeping the channel sharing and the channel map
+     * 
+     * @tparam Other coefficient type of the copy
+     * @return std::shared_ptr<const SRTensorT<Other>> 
+     */
+    template <typename Other>
+    std::shared_ptr<const SRTensorT<Other>> Cast() const;
+};
+
+using SRTensor = SRTensorT<double>;
+
+/** Shared, read-only step response coefficients. Parsed once and referenced by every FSRModel of a system */
+using SRTensorPtr = std::shared_ptr<const SRTensor>;
+
+/**
+ * @brief Get the parsed step responses in precision Scalar. The double tensor is shared, other precisions are copied
+ * 
+ * @tparam Scalar coefficient type
+ * @param SR parsed step responses
+ * @return std::shared_ptr<const SRTensorT<Scalar>> 
+ */
+template <typename Scalar>
+std::shared_ptr<const SRTensorT<Scalar>> ToPrecision(const SRTensorPtr& SR) {
+    if constexpr (std::is_same_v<Scalar, double>) {
+        return SR;
+    } else {
+        return SR->template Cast<Scalar>();
+    }
+}
+
+#endif // SR_TENSOR_H
@@ -0,0 +1,62 @@
+/**
+ * @file StateSpaceModel.h
+ * @author Geir Ola Tvinnereim
+ * @copyright  Released under the terms of the BSD 3-Clause License
+ * @date 2023
+ */
+
+#ifndef STATE_SPACE_MODEL_H
+#define STATE_SPACE_MODEL_H
+
+#include "model/SRTensor.h"
+
+#include <memory>
+#include <string>
+
+#include <Eigen/Dense>
+using VectorXd = Eigen::VectorXd;
+using MatrixXd = Eigen::MatrixXd;
+
+/**
+ * @brief Discrete state space realization of the step responses,
+ * x(k+1) = A x(k) + B u(k), y(k) = y0 + C x(k). The impulse response of the realization, C A^(k-1) B,
+ * approximates S(k) - S(k-1), and u is held at U(k-N) before the model starts, like Psi of the FSR model
+ */
+struct StateSpaceModel {
+    MatrixXd A; /** State transition, (n_x, n_x) */
+    MatrixXd B; /** Input matrix, (n_x, n_MV) */
+    MatrixXd C; /** Output matrix, (n_CV, n_x) */
+    VectorXd hankel_sv; /** Singular values of the Hankel matrix, the first n_x are kept */
+    MatrixXd step_error; /** Max step response error of every channel, relative to max|S_ij|, (n_CV, n_MV) */
+
+    int getOrder() const { return int(A.rows()); }
+
+    /**
+     * @brief Settled state of a constant input, x = (I - A)^-1 B u
+     *
+     * @param u constant input, n_MV
+     * @return VectorXd n_x
+     */
+    VectorXd SteadyState(const VectorXd& u) const;
+
+    /**
+     * @brief Summary of the realization: order, worst channel error and the kept and first discarded Hankel singular values
+     *
+     * @return std::string one line report
+     */
+    std::string Report() const;
+};
+
+/**
+ * @brief Realize the step responses as a state space model of a given order by the Eigensystem Realization Algorithm.
+ * The Markov parameters S(k) - S(k-1) fill the block Hankel matrices H0 and H1, H1 being H0 shifted one step.
+ * With the truncated SVD H0 = U_n Sigma_n V_n^T, A = Sigma_n^-1/2 U_n^T H1 V_n Sigma_n^-1/2, B is the first n_MV columns
+ * of Sigma_n^1/2 V_n^T and C the first n_CV rows of U_n Sigma_n^1/2. The step responses of the realization are compared to S
+ *
+ * @param SR step response tensor
+ * @param order state dimension n_x, at most the rank of H0
+ * @return std::shared_ptr<const StateSpaceModel>
+ */
+std::shared_ptr<const StateSpaceModel> RealizeERA(const SRTensor& SR, int order);
+
+#endif // STATE_SPACE_MODEL_H
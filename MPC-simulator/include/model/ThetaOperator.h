@@ -0,0 +1,135 @@
+/**
+ * @file ThetaOperator.h
+ * @author Geir Ola Tvinnereim
+ * @copyright  Released under the terms of the BSD 3-Clause License
+ * @date 2023
+ */
+
+#ifndef THETA_OPERATOR_H
+#define THETA_OPERATOR_H
+
+#include "model/SRTensor.h"
+#include "model/ThreadPool.h"
+
+#include <vector>
+#include <memory>
+#include <complex>
+
+#include <Eigen/Dense>
+#include <unsupported/Eigen/FFT>
+using VectorXd = Eigen::VectorXd;
+using VectorXcd = Eigen::VectorXcd;
+
+/**
+ * @brief Kernel used to apply the Theta operator
+ */
+enum class ThetaKernel {
+    AUTO, // Choose kernel by size
+    DIRECT, // Direct convolution, O((P-W) * M) per channel
+    FFT // FFT convolution, O((P+M) log(P+M)) per channel
+};
+
+/**
+ * @brief Structured Theta operator. Every SISO block of Theta is lower triangular Toeplitz,
+ * such that Theta * du is a convolution of the step responses with du.
+ * 
+ * @tparam Scalar coefficient type, double or float. Instantiated in ThetaOperator.cc
+ */
+template <typename Scalar>
+class ThetaOperatorT {
+public:
+    using VectorXs = Eigen::Matrix<Scalar, Eigen::Dynamic, 1>;
+    using VectorXcs = Eigen::Matrix<std::complex<Scalar>, Eigen::Dynamic, 1>;
+    using TensorPtr = std::shared_ptr<const SRTensorT<Scalar>>;
+
+private:
+    int n_CV_, n_MV_; /** Number of controlled and manipulated variables */
+    int P_, M_, W_; /** Horizons */
+    ThetaKernel kernel_; /** Kernel in use, DIRECT or FFT */
+    int nfft_; /** FFT length, >= P + M - 1 */
+
+    TensorPtr SR_; /** Shared step response coefficients */
+    std::vector<int> dead_time_; /** Dead time of each channel, index cv * n_MV + mv. Leading rows of a Theta block are zero */
+    std::vector<VectorXcs> spectra_; /** Half spectrum of [S(1), ..., S(P)] of each canonical vector, see SRTensor::Deduplicate, empty if only zero channels use it */
+
+    /**
+     * @brief Half spectrum FFT engine of the calling thread. The engine caches plans, one engine per thread keeps 
+     * the operator reentrant, e.g. when forked models sharing it are stepped on several threads
+     *
+     * @return Eigen::FFT<Scalar>&
+     */
+    static Eigen::FFT<Scalar>& getEngine();
+
+    /**
+     * @brief Choose kernel by comparing the estimated flop count of the direct and FFT convolution
+     *
+     * @return ThetaKernel DIRECT or FFT
+     */
+    ThetaKernel ChooseKernel() const;
+
+    /**
+     * @brief Precompute the spectra of the step responses, one canonical vector per task
+     * 
+     * @param pool thread pool
+     */
+    void setSpectra(ThreadPool& pool);
+
+    /**
+     * @brief Theta * du by direct convolution of the step responses
+     *
+     * @param du dim(du) = n_MV * M
+     * @return VectorXs n_CV * (P-W)
+     */
+    VectorXs ApplyDirect(const VectorXs& du) const;
+
+    /**
+     * @brief Theta * du by FFT convolution
+     *
+     * @param du dim(du) = n_MV * M
+     * @return VectorXs n_CV * (P-W)
+     */
+    VectorXs ApplyFFT(const VectorXs& du) const;
+
+public:
+    static constexpr double kDeadTimeTol = 1e-9; /** Relative magnitude below which leading step coefficients are dead time */
+
+    /**
+     * @brief Empty constructor
+     */
+    ThetaOperatorT() : n_CV_{0}, n_MV_{0}, P_{0}, M_{0}, W_{0}, kernel_{ThetaKernel::DIRECT}, nfft_{0} {}
+
+    /**
+     * @brief Construct a new Theta operator
+     *
+     * @param SR shared step coefficient tensor
+     * @param P Prediction horizon
+     * @param M Control horizon
+     * @param W Start horizon
+     * @param kernel Kernel, AUTO chooses by size
+     * @param pool thread pool used to precompute the spectra, nullptr runs serially
+     */
+    ThetaOperatorT(TensorPtr SR, int P, int M, int W, ThetaKernel kernel = ThetaKernel::AUTO, ThreadPool* pool = nullptr);
+
+    /**
+     * @brief Theta * du
+     *
+     * @param du dim(du) = n_MV * M
+     * @return VectorXs n_CV * (P-W)
+     */
+    VectorXs Apply(const VectorXs& du) const;
+
+    ThetaKernel getKernel() const { return kernel_; }
+
+    /**
+     * @brief Get the dead time of a channel. Column c of Theta block (cv, mv) is zero above row max(d + c - W, 0)
+     * 
+     * @param cv cv index
+     * @param mv mv index
+     * @return int dead time d
+     */
+    int getDeadTime(int cv, int mv) const { return dead_time_[cv * n_MV_ + mv]; }
+};
+
+using ThetaOperator = ThetaOperatorT<double>;
+
+#endif // THETA_OPERATOR_H
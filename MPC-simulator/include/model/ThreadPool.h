@@ -0,0 +1,72 @@
+/**
+ * @file ThreadPool.h
+ * @author Geir Ola Tvinnereim
+ * @copyright  Released under the terms of the BSD 3-Clause License
+ * @date 2023
+ */
+
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <atomic>
+
+/**
+ * @brief Fixed size pool of worker threads executing parallel for loops. 
+ * Tasks must write to disjoint memory, such that the result is independent of the scheduling.
+ */
+class ThreadPool {
+private:
+    std::vector<std::thread> workers_; /** Worker threads, n_threads - 1, the calling thread participates */
+    std::mutex mutex_;
+    std::condition_variable start_cv_, done_cv_;
+
+    const std::function<void(int)>* body_; /** Body of the current loop */
+    int count_; /** Number of iterations of the current loop */
+    std::atomic<int> next_; /** Next iteration to be claimed */
+    int active_; /** Workers still executing the current loop */
+    unsigned long generation_; /** Incremented for every loop, wakes the workers */
+    bool stop_;
+
+    /**
+     * @brief Claim and execute iterations until the loop is exhausted
+     */
+    void RunIterations();
+
+    /**
+     * @brief Worker main loop
+     */
+    void WorkerLoop();
+
+public:
+    /**
+     * @brief Construct a new thread pool
+     * 
+     * @param n_threads number of threads, including the calling thread. n_threads <= 1 runs loops serially
+     */
+    explicit ThreadPool(int n_threads = 1);
+
+    /**
+     * @brief Join the worker threads
+     */
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    /**
+     * @brief Execute body(0), ..., body(count - 1) on the pool, returns when every iteration is done
+     * 
+     * @param count number of iterations
+     * @param body loop body
+     */
+    void ParallelFor(int count, const std::function<void(int)>& body);
+
+    int getNumThreads() const { return int(workers_.size()) + 1; }
+};
+
+#endif // THREAD_POOL_H
@@ -33,4 +33,48 @@ void TestSerializeScenario(const string& sce, const string& sys, const string& S
  */
 void TestSimulate(const string& sys, const string& ref_vec, int T);
 
+/**
+ * @brief Benchmark FSRModel construction of a synthetic system, doubling the number of threads up to max_threads. 
+ * Prints the construction time and speedup of every thread count, and verifies that Theta is identical to the serial result
+ * 
+ * @param n_CV number of controlled variables
+ * @param n_MV number of manipulated variables
+ * @param N number of step coefficients
+ * @param P Prediction horizon
+ * @param M Control horizon
+ * @param max_threads largest number of threads
+ */
+void BenchmarkModelConstruction(int n_CV, int n_MV, int N, int P, int M, int max_threads);
+
+/**
+ * @brief Validate the float32 mode. Simulate the closed loop of scenario sce_sys.json with a float64 and a float32 FSRModel,
+ * and print the maximum deviation of the float32 actuation and output trajectories from the float64 baseline
+ * 
+ * @param sys System name
+ * @param ref_str vector of references, must concide with system
+ * @param T MPC horizon
+ */
+void ValidatePrecision(const string& sys, const string& ref_str, int T);
+
+/**
+ * @brief Benchmark FSRModel::fork against construction for scenario sce_sys.json. Prints the construction time and 
+ * the mean time of n_forks forks. Verifies that every fork starts at the free response of the origin, that forks stepped 
+ * and predicting concurrently on a thread pool agree with a serial reference, and that stepping the forks leaves the origin unchanged
+ * 
+ * @param sys System name
+ * @param n_forks number of forks
+ * @param threads number of threads stepping the forks
+ */
+void BenchmarkFork(const string& sys, int n_forks, int threads);
+
+/**
+ * @brief Validate the state space free response of scenario sce_sys.json. Steps an FSR model and a fork using a realization 
+ * of the given order with the same moves, and prints the realization report and the maximum deviation of Lambda between the engines
+ * 
+ * @param sys System name
+ * @param order order of the realization, see RealizeERA
+ * @param steps number of UpdateU steps
+ */
+void ValidateStateSpace(const string& sys, int order, int steps);
+
 #endif // TESTS_H
\ No newline at end of file
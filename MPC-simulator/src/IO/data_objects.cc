@@ -10,6 +10,8 @@
 
 #include <stdexcept>
 #include <iostream>
+#include <algorithm>
+#include <cmath>
 
 /**
  * @brief Convert a nlohmann::json::array to Eigen::VectorXd
@@ -17,7 +19,7 @@
  * @param vec Eigen::VectorXD
  * @param arr nlohmann::json::array
  */
-static void EigenFromJson(VectorXd& vec, const json& arr) {
+static void EigenFromJson(Eigen::Ref<VectorXd> vec, const json& arr) {
     int i = 0;
     for (auto& elem : arr) {
         vec(i++) = (double) elem;
@@ -46,7 +48,7 @@ CVData::CVData(const json& cv_data, int n_MV, int n_CV, int N) : n_CV_{n_CV}, n_
     if (n_outputs != n_CV) {
         throw std::invalid_argument("n_CV does not coincide with CV");
     }
-    AllocateVectors();
+    auto SR = std::make_shared<SRTensor>(n_CV_, n_MV_, N_);
     
     int i = 0; // cv counter
     for (auto& cv : cv_data) {
@@ -57,60 +59,17 @@ CVData::CVData(const json& cv_data, int n_MV, int n_CV, int N) : n_CV_{n_CV}, n_
         json s_data = cv.at(kS); // Fetching s coefficients
         PaddSData(s_data, i); // Padd if needed
         for (int mv = 0; mv < n_MV_; mv++) {
-            FillSR(s_data, i, mv);
+            FillSR(*SR, s_data, i, mv);
         }
         i++;
-    }                          
-}
-
-CVData::~CVData() {
-    if (n_CV_ != 0 && n_MV_ != 0) {
-        for (int i = 0 ; i < n_CV_; i++) {
-            delete[] pp_SR_vec_[i];
-        }
-        delete[] pp_SR_vec_;
-    }
-}
-
-void CVData::AllocateVectors() {
-    // Allocate matrix of Eigen::VectorXd
-    pp_SR_vec_ = new VectorXd*[n_CV_];
-    for (int i = 0; i < n_CV_; i++) {
-        pp_SR_vec_[i] = new VectorXd[n_MV_];
-    }
-    for (int row = 0; row < n_CV_; row++) {
-        for (int col = 0; col < n_MV_; col++) {
-            pp_SR_vec_[row][col] = VectorXd::Zero(N_);
-        }
     }
+    SR->Deduplicate(); // Share identical and gain-scaled step responses
+    SR->UpdateChannelMap(); // Detect uncoupled CV/MV pairs
+    SR_ = SR; // Read-only from here on
 }
 
-CVData& CVData::operator=(const CVData& rhs) {
-    // Implemented without deep-copying. Since we assume default constructor is called first. 
-    n_CV_ = rhs.n_CV_;
-    n_MV_ = rhs.n_MV_;
-    N_ = rhs.N_;
-    outputs_ = rhs.outputs_;
-    inits_ = rhs.inits_;
-    units_ = rhs.units_;
-
-    // Deep copying
-    pp_SR_vec_ = new VectorXd*[n_CV_];
-    for (int cv = 0; cv < n_CV_; cv++) {
-        pp_SR_vec_[cv] = new VectorXd[n_MV_];
-    }
-    for (int row = 0; row < n_CV_; row++) {
-        for (int col = 0; col < n_MV_; col++) {
-            pp_SR_vec_[row][col] = rhs.pp_SR_vec_[row][col];
-        }
-    }
-    return *this;
-}
-
-void CVData::FillSR(const json& s_data, int cv, int mv) {
-    VectorXd vec = VectorXd::Zero(N_);
-    EigenFromJson(vec, s_data.at(mv));
-    pp_SR_vec_[cv][mv] = vec;    
+void CVData::FillSR(SRTensor& SR, const json& s_data, int cv, int mv) {
+    EigenFromJson(SR.getChannel(cv, mv), s_data.at(mv));
 }
 
 MVData::MVData() {}
@@ -127,7 +86,31 @@ MVData::MVData(const json& mv_data, int n_MV) {
     }             
 }
 
-MPCConfig::MPCConfig() : P(), M(), W() {
+int CVData::TruncateSR(double tol, int min_N) {
+    int N = 1;
+    for (int i = 0; i < n_CV_; i++) {
+        for (int j = 0; j < n_MV_; j++) {
+            N = std::max(N, SR_->getSettlingIndex(i, j, tol) + 1);
+        }
+    }
+    N = std::min(std::max(N, min_N), N_);
+    if (N < N_) {
+        SR_ = SR_->Truncate(N);
+        N_ = N;
+    }
+    return N_;
+}
+
+int CVData::ResampleSR(int factor) {
+    if (factor > 1) {
+        SR_ = SR_->Resample(factor);
+        N_ = SR_->getN();
+    }
+    return N_;
+}
+
+MPCConfig::MPCConfig() : P(), M(), W(), truncate_tol(), threads(1), single_precision(false), laguerre_order(0), laguerre_pole(0), 
+                         ss_order(0), resample(1) {
     disable_slack = false;
 }
 MPCConfig::MPCConfig(const json& sce_data) {
@@ -135,6 +118,52 @@ MPCConfig::MPCConfig(const json& sce_data) {
     P = mpc_data.at(kP);
     M = mpc_data.at(kM);
     W = mpc_data.at(kW);
+    truncate_tol = mpc_data.value(kTruncateTol, 0.0); // Optional
+    if (truncate_tol < 0) {
+        throw std::invalid_argument("Negative truncation tolerance");
+    }
+    threads = mpc_data.value(kThreads, 1); // Optional
+    if (threads < 1) {
+        throw std::invalid_argument("Number of threads must be positive");
+    }
+    const string precision = mpc_data.value(kPrecision, kFloat64); // Optional
+    if (precision != kFloat64 && precision != kFloat32) {
+        throw std::invalid_argument("Precision must be " + kFloat64 + " or " + kFloat32);
+    }
+    single_precision = (precision == kFloat32);
+    blocking = mpc_data.value(kBlocking, std::vector<int>()); // Optional
+    for (int length : blocking) {
+        if (length < 1) {
+            throw std::invalid_argument("Move blocks must be at least one step");
+        }
+    }
+    laguerre_order = mpc_data.value(kLaguerreOrder, 0); // Optional
+    laguerre_pole = mpc_data.value(kLaguerrePole, 0.0);
+    if (laguerre_order < 0 || laguerre_order > M) {
+        throw std::invalid_argument("Laguerre order must be in [0, M]");
+    }
+    if (laguerre_pole < 0 || laguerre_pole >= 1) {
+        throw std::invalid_argument("Laguerre pole must be in [0, 1)");
+    }
+    if (laguerre_order > 0 && !blocking.empty()) {
+        throw std::invalid_argument("Move blocking and Laguerre functions can not be combined");
+    }
+    ss_order = mpc_data.value(kSSOrder, 0); // Optional
+    resample = mpc_data.value(kResample, 1); // Optional
+    if (resample < 1) {
+        throw std::invalid_argument("Resampling factor must be positive");
+    }
+    if (ss_order < 0) {
+        throw std::invalid_argument("Negative state space order");
+    }
+    coincidence_points = mpc_data.value(kCoincidencePoints, std::vector<int>()); // Optional
+    std::sort(coincidence_points.begin(), coincidence_points.end());
+    coincidence_points.erase(std::unique(coincidence_points.begin(), coincidence_points.end()), coincidence_points.end());
+    for (int point : coincidence_points) {
+        if (point <= W || point > P) {
+            throw std::out_of_range("Coincidence points must be in (W, P]");
+        }
+    }
 
     // Recall sizes
     int n_CV = int(mpc_data.at(kQ).size());
@@ -172,6 +201,67 @@ MPCConfig::MPCConfig(const json& sce_data) {
             R[i] = r;
         }
     }
+    // Store Y constraint windows
+    constraint_windows = mpc_data.value(kConstraintWindows, std::vector<std::vector<int>>()); // Optional
+    if (!constraint_windows.empty() && int(constraint_windows.size()) != n_CV) {
+        throw std::invalid_argument("A constraint window is needed for every CV");
+    }
+    for (const std::vector<int>& window : constraint_windows) {
+        if (window.size() < 2 || window.size() > 3) {
+            throw std::invalid_argument("Constraint windows must be [first, stride] or [first, stride, last]");
+        }
+        if (window[0] <= W || window[0] > P || window[1] < 1 || (window.size() == 3 && (window[2] < window[0] || window[2] > P))) {
+            throw std::out_of_range("Constraint windows must lie in (W, P] with a positive stride");
+        }
+    }
+}
+
+std::vector<int> MPCConfig::getBlockStarts() const {
+    std::vector<int> starts;
+    if (blocking.empty()) {
+        for (int k = 0; k < M; k++) {
+            starts.push_back(k);
+        }
+        return starts;
+    }
+    for (int i = 0, start = 0; i < int(blocking.size()) && start < M; start += blocking[i++]) {
+        starts.push_back(start);
+    }
+    return starts;
+}
+
+bool MPCConfig::isConstrainedStep(int cv, int step) const {
+    if (constraint_windows.empty()) {
+        return true;
+    }
+    const std::vector<int>& window = constraint_windows[cv];
+    const int last = window.size() == 3 ? window[2] : P;
+    return step >= window[0] && step <= last && (step - window[0]) % window[1] == 0;
+}
+
+void MPCConfig::Resample() {
+    if (resample <= 1) {
+        return;
+    }
+    const int r = resample;
+    auto ceil_div = [r](int steps) { return (steps + r - 1) / r; };
+    P = ceil_div(P);
+    M = ceil_div(M);
+    W = W / r;
+    for (int& length : blocking) {
+        length = ceil_div(length);
+    }
+    laguerre_order = std::min(laguerre_order, M);
+    laguerre_pole = std::pow(laguerre_pole, r);
+    for (int& point : coincidence_points) {
+        point = ceil_div(point);
+    }
+    coincidence_points.erase(std::unique(coincidence_points.begin(), coincidence_points.end()), coincidence_points.end());
+    for (std::vector<int>& window : constraint_windows) {
+        for (int& step : window) {
+            step = ceil_div(step);
+        }
+    }
 }
 
 void MPCConfig::DetermineSlack(const json& mpc_data, int n_CV) {
@@ -87,6 +87,46 @@ static void ValidateConstraints(const VectorXd& z_min, const VectorXd& z_max, st
     }
 }
 
+/**
+ * @brief Resample the step responses to the controller period if enabled in the MPC configuration. 
+ * The horizons and the time indexed settings are converted to controller periods, the rate limits are scaled 
+ * to one controller period and N of the model parameters is updated
+ * 
+ * @param conf MPCConfig
+ * @param m_map model parameters
+ * @param cvd CVData
+ * @param z_min lower constraints, [du, u, y]
+ * @param z_max upper constraints, [du, u, y]
+ */
+static void ResampleModel(MPCConfig& conf, std::map<string, int>& m_map, CVData& cvd, VectorXd& z_min, VectorXd& z_max) {
+    if (conf.resample <= 1) {
+        return;
+    }
+    const int N = m_map[kN], n_MV = m_map[kN_MV];
+    m_map[kN] = cvd.ResampleSR(conf.resample);
+    conf.Resample();
+    z_min.head(n_MV) *= conf.resample;
+    z_max.head(n_MV) *= conf.resample;
+    std::cout << "Step responses resampled by " << conf.resample << ", N = " << N << " -> " << m_map[kN]
+              << ", P = " << conf.P << ", M = " << conf.M << ", W = " << conf.W << std::endl;
+}
+
+/**
+ * @brief Truncate settled step response tails if enabled in the MPC configuration, updating N of the model parameters
+ * 
+ * @param conf MPCConfig
+ * @param m_map model parameters
+ * @param cvd CVData
+ */
+static void TruncateModel(const MPCConfig& conf, std::map<string, int>& m_map, CVData& cvd) {
+    if (conf.truncate_tol <= 0) {
+        return;
+    }
+    const int N = m_map[kN];
+    m_map[kN] = cvd.TruncateSR(conf.truncate_tol, conf.P + 1);
+    std::cout << "Step responses truncated at tolerance " << conf.truncate_tol << ", N = " << N << " -> " << m_map[kN] << std::endl;
+}
+
 /**
  * @brief high-level function parsing system file
  * 
@@ -216,6 +256,8 @@ void ParseNew(const string& sce_filepath, std::map<string, int>& m_map,
         }
     }
     ValidateConstraints(z_min, z_max, m_map);
+    ResampleModel(conf, m_map, cvd, z_min, z_max);
+    TruncateModel(conf, m_map, cvd);
 }
 
 void Parse(const string& sce_filepath, const string& sim_filepath, std::map<string, int>& m_map,
@@ -238,6 +280,8 @@ void Parse(const string& sce_file, const string& sys_file, std::map<string, int>
     string system; // Dummy variable
     ParseScenarioData(sce_data, system, conf, z_min, z_max);
     ParseSystemData(sys_data, m_map, cvd, mvd);
+    ResampleModel(conf, m_map, cvd, z_min, z_max);
+    TruncateModel(conf, m_map, cvd);
 }
 
 void ParseOpenLoop(const string& system, std::map<string, int>& m_map, CVData& cvd, MVData& mvd) {
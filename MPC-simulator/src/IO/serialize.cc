@@ -40,7 +40,8 @@ static void FillVector(json& vector, const MatrixXd& mat, int row) {
  * @param fsr FSRModel
  * @param T MPC horizon
  */
-static void SerializeSimData(json& data, const string& scenario, const FSRModel& fsr, int T) {
+template <typename Scalar>
+static void SerializeSimData(json& data, const string& scenario, const FSRModelT<Scalar>& fsr, int T) {
     data[kScenario] = scenario;
     data[kT] = T;
     data[kN_CV] = fsr.getN_CV();
@@ -49,9 +50,10 @@ static void SerializeSimData(json& data, const string& scenario, const FSRModel&
     data[kM] = fsr.getM();
 
     json du_tilde = json::array();
+    const MatrixXd du_tilde_mat = fsr.getDuTildeMat(); // Unroll ring buffer once
     for (int i = 0; i < fsr.getN_MV(); i++) {
         json row_arr = json::array();
-        FillVector(row_arr, fsr.getDuTildeMat(), i);
+        FillVector(row_arr, du_tilde_mat, i);
         du_tilde.push_back(row_arr);
     }
     data[kDuTilde] = du_tilde;
@@ -245,9 +247,10 @@ void WriteJson(const json& data, const string& filepath) {
 //////////////////////////////////
 
 // Serialize for new simulation
+template <typename Scalar>
 void SerializeSimulationNew(const string& write_path, const string& scenario, const CVData& cvd, const MVData& mvd, 
                     const MatrixXd& y_pred, const MatrixXd& u_mat, const VectorXd& z_min, const VectorXd& z_max, 
-                    const MatrixXd& ref, const FSRModel& fsr, int T) {
+                    const MatrixXd& ref, const FSRModelT<Scalar>& fsr, int T) {
     json data;
     SerializeSimData(data, scenario, fsr, T);
     SerializeSimCV(data, cvd, y_pred, z_min, z_max, ref, fsr.getN_CV(), fsr.getN_MV());
@@ -293,9 +296,10 @@ void SerializeSimulation(const string& write_path, const MatrixXd& y_pred, const
 }
 
 // Serialization for Web application
+template <typename Scalar>
 string SerializeSimulation(const string& scenario, const CVData& cvd, const MVData& mvd, 
                     const MatrixXd& y_pred, const MatrixXd& u_mat, const VectorXd& z_min, const VectorXd& z_max,
-                    const MatrixXd& ref, const FSRModel& fsr, int T) {
+                    const MatrixXd& ref, const FSRModelT<Scalar>& fsr, int T) {
     json data;
     SerializeSimData(data, scenario, fsr, T);
     SerializeSimCV(data, cvd, y_pred, z_min, z_max, ref, fsr.getN_CV(), fsr.getN_MV());
@@ -303,6 +307,15 @@ string SerializeSimulation(const string& scenario, const CVData& cvd, const MVDa
     return to_string(data);
 }
 
+template void SerializeSimulationNew(const string&, const string&, const CVData&, const MVData&, const MatrixXd&, const MatrixXd&, 
+                    const VectorXd&, const VectorXd&, const MatrixXd&, const FSRModelT<double>&, int);
+template void SerializeSimulationNew(const string&, const string&, const CVData&, const MVData&, const MatrixXd&, const MatrixXd&, 
+                    const VectorXd&, const VectorXd&, const MatrixXd&, const FSRModelT<float>&, int);
+template string SerializeSimulation(const string&, const CVData&, const MVData&, const MatrixXd&, const MatrixXd&, 
+                    const VectorXd&, const VectorXd&, const MatrixXd&, const FSRModelT<double>&, int);
+template string SerializeSimulation(const string&, const CVData&, const MVData&, const MatrixXd&, const MatrixXd&, 
+                    const VectorXd&, const VectorXd&, const MatrixXd&, const FSRModelT<float>&, int);
+
 void SerializeOpenLoop(const string& write_path, const string& scenario, const CVData& cvd, const MVData& mvd, 
                     const MatrixXd& y_pred, const MatrixXd& u_mat, const FSRModel& fsr, int T) {
     json data;
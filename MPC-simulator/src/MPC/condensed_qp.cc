@@ -6,40 +6,72 @@
  */
 #include "MPC/condensed_qp.h"
 #include <limits>
+#include <algorithm>
+
+using Triplets = std::vector<Eigen::Triplet<double>>;
 
 /**
- * @brief Helper function. Implementing block diagonal matrix
+ * @brief Helper function. Append the nonzeros of a dense block to the triplets of a sparse matrix. 
+ * Exact zeros are skipped, as by sparseView
  * 
- * @param blk_mat Eigen::SparseMatrix<double> to be block diagonalized
- * @param arg block argument
- * @param count Number of blocks
+ * @param triplets triplets of the sparse matrix
+ * @param block dense block
+ * @param row first row of the block
+ * @param col first column of the block
  */
-static void blkdiag(SparseXd& blk_mat, const MatrixXd& arg, int count) {
-    MatrixXd mat = MatrixXd::Zero(arg.rows() * count, arg.cols() * count);
-    for (int i = 0; i < count; i++) {
-        mat.block(i * arg.rows(), i * arg.cols(), arg.rows(), arg.cols()) = arg;
+static void AppendBlock(Triplets& triplets, const Eigen::Ref<const MatrixXd>& block, int row, int col) {
+    for (int j = 0; j < block.cols(); j++) {
+        for (int i = 0; i < block.rows(); i++) {
+            if (block(i, j) != 0) {
+                triplets.emplace_back(row + i, col + j, block(i, j));
+            }
+        }
     }
-    blk_mat = mat.sparseView();
 }
 
 /**
- * @brief Set the Tau object, sliced from @param ref
+ * @brief Helper function. Append an identity block to the triplets of a sparse matrix
  * 
- * @param ref Reference data
- * @param P Prediction horizon
- * @param W Delay horizon
- * @param n_CV Number of controlled variables
- * @param k MPC simulation step
- * @return Eigen::MatrixXd tau
+ * @param triplets triplets of the sparse matrix
+ * @param size size of the identity
+ * @param row first row of the block
+ * @param col first column of the block
  */
-static VectorXd setTau(const MatrixXd& ref, int P, int W, int n_CV, int k) { 
-    VectorXd tau = VectorXd::Zero(n_CV * (P - W));
-    for (int i = 0; i < n_CV; i++) {
-        int start_index = k + W; 
-        VectorXd tmp = ref(i, Eigen::seq(start_index, start_index + (P - W) - 1));
-        tau.block(i * (P - W), 0, (P - W), 1) = tmp; 
+static void AppendIdentity(Triplets& triplets, int size, int row, int col) {
+    for (int i = 0; i < size; i++) {
+        triplets.emplace_back(row + i, col + i, 1.0);
     }
-    return tau;
+}
+
+/**
+ * @brief Helper function. Assemble a sparse matrix from triplets, the number of nonzeros being known up front
+ * 
+ * @param triplets triplets, no duplicates
+ * @param rows number of rows
+ * @param cols number of columns
+ * @return SparseXd 
+ */
+static SparseXd FromTriplets(const Triplets& triplets, int rows, int cols) {
+    SparseXd mat(rows, cols);
+    mat.setFromTriplets(triplets.begin(), triplets.end());
+    return mat;
+}
+
+/**
+ * @brief Helper function. Sparse diagonal matrix, zero entries are not stored
+ * 
+ * @param diagonal diagonal entries
+ * @return SparseXd 
+ */
+static SparseXd DiagonalMatrix(const VectorXd& diagonal) {
+    Triplets triplets;
+    triplets.reserve(diagonal.rows());
+    for (int i = 0; i < diagonal.rows(); i++) {
+        if (diagonal(i) != 0) {
+            triplets.emplace_back(i, i, diagonal(i));
+        }
+    }
+    return FromTriplets(triplets, diagonal.rows(), diagonal.rows());
 }
 
 /**
@@ -47,24 +79,23 @@ static VectorXd setTau(const MatrixXd& ref, int P, int W, int n_CV, int k) {
  * 
  * @param bound Eigen::VectorXd representing a bound constraint
  * @param fsr FSRModel Finite step response model
- * @param K_inv Eigen::MatrixXd lower triangular matrix
  * @param Gamma Eigen::SparseXd 
  * @param m Number of constraints 
  * @param n Number of optimalization variables
  */
-static void UpdateBounds(VectorXd& bound, FSRModel& fsr, const MatrixXd& K_inv, 
-                const SparseXd& Gamma, int m, int a) { 
+template <typename Scalar>
+static void UpdateBounds(VectorXd& bound, FSRModelT<Scalar>& fsr, const SparseXd& Gamma, int m, int a) { 
     // c = [ 0 (a),
     //       K⁽⁻¹⁾ Gamma U(k-N) (a),
-    //       Lambda (n_CV * (P-W)),
-    //       Lambda (n_CV * (P-W)),
+    //       Lambda (constraint rows),
+    //       Lambda (constraint rows),
     //       0 (n_CV),
     //       0 (n_CV)]
     VectorXd c = VectorXd::Zero(m);
-    VectorXd lambda = fsr.getLambda();
+    VectorXd lambda = fsr.getLambda()(fsr.getConstraintRows()).template cast<double>();
     int size_lambda = lambda.rows();
 
-    c.block(a, 0, a, 1) = K_inv * Gamma * fsr.getUK();
+    c.block(a, 0, a, 1) = ApplyKInv(Gamma * fsr.getUK().template cast<double>(), fsr.getN_MV());
     c.block(2 * a, 0, size_lambda, 1) = lambda;
     c.block(2 * a + size_lambda, 0, size_lambda, 1) = lambda;
     bound -= c; // Subtract k-dependant part
@@ -75,34 +106,147 @@ static void UpdateBounds(VectorXd& bound, FSRModel& fsr, const MatrixXd& K_inv,
  * 
  * @param bound Eigen::VectorXd representing a bound constraint
  * @param fsr FSRModel Finite step response model
- * @param K_inv Eigen::MatrixXd lower triangular matrix
  * @param Gamma Eigen::SparseXd 
  * @param m Number of constraints 
  * @param n Number of optimalization variables
  */
-static void UpdateBoundsWoSlack(VectorXd& bound, FSRModel& fsr, const MatrixXd& K_inv, 
-                const SparseXd& Gamma, int m, int n) {
+template <typename Scalar>
+static void UpdateBoundsWoSlack(VectorXd& bound, FSRModelT<Scalar>& fsr, const SparseXd& Gamma, int m, int n) {
     // c = [0 (n),
-    //      K_inv * Gamma * U(k-N) (n),
-    //      Lambda (m - 2n)]
+    //      K⁽⁻¹⁾ Gamma U(k-N) (n),
+    //      Lambda (constraint rows, m - 2n)]
     VectorXd c = VectorXd::Zero(m);
-    c.block(n, 0, n, 1) = K_inv * Gamma * fsr.getUK();
-    c.block(2 * n, 0, m - 2 * n, 1) = fsr.getLambda();
+    c.block(n, 0, n, 1) = ApplyKInv(Gamma * fsr.getUK().template cast<double>(), fsr.getN_MV());
+    c.block(2 * n, 0, m - 2 * n, 1) = fsr.getLambda()(fsr.getConstraintRows()).template cast<double>();
     bound -= c; // Subtract k-dependant part
 }
 
+/**
+ * @brief Split rows of Theta into the rows of every CV block
+ * 
+ * @param rows ascending rows of Theta
+ * @param size_y P - W
+ * @param n_CV Number of controlled variables
+ * @return std::vector<std::vector<int>> rows of every CV, empty if none
+ */
+static std::vector<std::vector<int>> RowsPerCV(const std::vector<int>& rows, int size_y, int n_CV) {
+    std::vector<std::vector<int>> per_cv(n_CV);
+    for (int row : rows) {
+        per_cv[row / size_y].push_back(row);
+    }
+    return per_cv;
+}
+
+/**
+ * @brief Upper triangle of Theta^T Q_bar Theta, a symmetric rank-k update over the nonzero channel blocks and cost rows of every CV. 
+ * With S_ij = Q_i^1/2 Theta_ij, Q_bar being diagonal and nonnegative, block (k, j) is the sum over CVs of S_ik^T S_ij. 
+ * Only the blocks k <= j are computed, one block per task, and the diagonal blocks by a self-adjoint rank update
+ * 
+ * @param theta Theta matrix
+ * @param q diagonal of Q_bar
+ * @param rows cost rows of Theta, movable rows at the coincidence points
+ * @param channels channel sparsity map
+ * @param pool thread pool, one block of the upper triangle per task
+ * @return MatrixXd (a, a), the strictly lower triangle is zero
+ */
+static MatrixXd ThetaQTheta(const MatrixXd& theta, const VectorXd& q, const std::vector<int>& rows, const ChannelMap& channels, 
+                            ThreadPool& pool) {
+    const int n_CV = channels.rows(), n_MV = channels.cols();
+    const int size_y = theta.rows() / n_CV, M = theta.cols() / n_MV;
+    const std::vector<std::vector<int>> per_cv = RowsPerCV(rows, size_y, n_CV);
+
+    // Scaled channel blocks S_ij, empty for zero channels and CVs without cost rows
+    std::vector<MatrixXd> scaled(n_CV * n_MV);
+    pool.ParallelFor(n_CV * n_MV, [&](int channel) {
+        const int i = channel / n_MV, j = channel % n_MV;
+        if (channels(i, j) && !per_cv[i].empty()) {
+            scaled[channel] = q(per_cv[i]).cwiseSqrt().asDiagonal() * theta(per_cv[i], Eigen::seqN(j * M, M));
+        }
+    });
+
+    std::vector<std::pair<int, int>> blocks; // (k, j), k <= j
+    for (int j = 0; j < n_MV; j++) {
+        for (int k = 0; k <= j; k++) {
+            blocks.emplace_back(k, j);
+        }
+    }
+    MatrixXd product = MatrixXd::Zero(theta.cols(), theta.cols());
+    pool.ParallelFor(blocks.size(), [&](int b) { // Every task writes a disjoint block
+        const int k = blocks[b].first, j = blocks[b].second;
+        auto block = product.block(k * M, j * M, M, M);
+        for (int i = 0; i < n_CV; i++) {
+            const MatrixXd& s_k = scaled[i * n_MV + k];
+            const MatrixXd& s_j = scaled[i * n_MV + j];
+            if (s_k.size() == 0 || s_j.size() == 0) {
+                continue;
+            }
+            if (k == j) {
+                block.selfadjointView<Eigen::Upper>().rankUpdate(s_j.transpose());
+            } else {
+                block.noalias() += s_k.transpose() * s_j;
+            }
+        }
+    });
+    return product;
+}
+
+/**
+ * @brief Helper function. Append the upper triangle of a dense symmetric block on the diagonal of the Hessian, column by column
+ * 
+ * @param G Hessian in CSC, columns inserted in order
+ * @param upper dense block, only the upper triangle is read
+ * @param offset first row and column of the block
+ * @param scale factor of every entry
+ */
+static void InsertUpper(SparseXd& G, const MatrixXd& upper, int offset, double scale) {
+    for (int c = 0; c < upper.cols(); c++) {
+        for (int r = 0; r <= c; r++) {
+            if (upper(r, c) != 0) {
+                G.insert(offset + r, offset + c) = scale * upper(r, c);
+            }
+        }
+    }
+}
+
+/**
+ * @brief Theta^T Q_bar 1, accumulated over the nonzero channel blocks and cost rows of every CV
+ * 
+ * @param theta Theta matrix
+ * @param q diagonal of Q_bar
+ * @param rows cost rows of Theta, movable rows at the coincidence points
+ * @param channels channel sparsity map
+ * @return MatrixXd (a, n_CV)
+ */
+static MatrixXd ThetaQOne(const MatrixXd& theta, const VectorXd& q, const std::vector<int>& rows, const ChannelMap& channels) {
+    const int n_CV = channels.rows(), n_MV = channels.cols();
+    const int size_y = theta.rows() / n_CV, M = theta.cols() / n_MV;
+    const std::vector<std::vector<int>> per_cv = RowsPerCV(rows, size_y, n_CV);
+    MatrixXd product = MatrixXd::Zero(theta.cols(), n_CV);
+    for (int i = 0; i < n_CV; i++) {
+        const std::vector<int>& cv_rows = per_cv[i];
+        for (int j = 0; j < n_MV && !cv_rows.empty(); j++) {
+            if (channels(i, j)) {
+                product.block(j * M, i, M, 1) = theta(cv_rows, Eigen::seqN(j * M, M)).transpose() * q(cv_rows);
+            }
+        }
+    }
+    return product;
+}
+
 SparseXd setOneMatrix(int P, int W, int n_CV) {
     // 1 = [1, 0, ..., 0
     //      ., 0, ..., .
     //      1_(P-W), 0, ..., 0
     //      ..., ..., ..., ...] See equation 32 thesis. 
 
-    MatrixXd one_matrix = MatrixXd::Zero((P-W) * n_CV, n_CV); 
-    VectorXd one_vector = VectorXd::Constant(P-W, 1);
+    Triplets triplets;
+    triplets.reserve((P-W) * n_CV);
     for (int i = 0; i < n_CV; i++) {
-        one_matrix.block(i * (P-W), i, P-W, 1) = one_vector;
+        for (int p = 0; p < P-W; p++) {
+            triplets.emplace_back(i * (P-W) + p, i, 1.0);
+        }
     }
-    return one_matrix.sparseView();
+    return FromTriplets(triplets, (P-W) * n_CV, n_CV);
 }
 
 /////////////////////////////
@@ -113,90 +257,177 @@ void setWeightMatrices(SparseXd& Q_bar, SparseXd& R_bar, const MPCConfig& conf)
     // Replicate and flatten Q and R matrices: 
     MatrixXd Q_replicate = conf.Q.replicate(1, conf.P - conf.W);
     VectorXd Q_flatten = Q_replicate.reshaped<Eigen::RowMajor>().transpose();
-    MatrixXd R_replicate = conf.R.replicate(1, conf.M);
+    if (!conf.coincidence_points.empty()) { // Only the coincidence points are tracked, prediction p is row p-W-1 of every CV
+        const int size_y = conf.P - conf.W;
+        for (int row = 0; row < Q_flatten.rows(); row++) {
+            const int point = row % size_y + conf.W + 1;
+            if (!std::binary_search(conf.coincidence_points.begin(), conf.coincidence_points.end(), point)) {
+                Q_flatten(row) = 0;
+            }
+        }
+    }
+    MatrixXd R_replicate = conf.R.replicate(1, conf.getBlockStarts().size()); // One move per block
     VectorXd R_flatten = R_replicate.reshaped<Eigen::RowMajor>().transpose();
-    MatrixXd Q_quad = Q_flatten.asDiagonal();
-    MatrixXd R = R_flatten.asDiagonal();
 
-    Q_bar = Q_quad.sparseView(); // dim(Q_bar) = n_CV * (P-W) x n_CV * (P-W)
-    R_bar = R.sparseView(); // dim(R_bar) = n_MV * M x n_MV * M
+    Q_bar = DiagonalMatrix(Q_flatten); // dim(Q_bar) = n_CV * (P-W) x n_CV * (P-W)
+    R_bar = DiagonalMatrix(R_flatten); // dim(R_bar) = n_MV * n_b x n_MV * n_b
+
+    if (conf.laguerre_order > 0) { // du = L z, R_bar = blkdiag(r_j L^T L), dim(R_bar) = n_MV * order x n_MV * order
+        const int order = conf.laguerre_order;
+        const MatrixXd laguerre = LaguerreBasis(conf.M, order, conf.laguerre_pole);
+        const MatrixXd gram = laguerre.transpose() * laguerre;
+        Triplets triplets;
+        triplets.reserve(conf.R.rows() * order * order);
+        for (int j = 0; j < conf.R.rows(); j++) {
+            AppendBlock(triplets, conf.R(j) * gram, j * order, j * order);
+        }
+        R_bar = FromTriplets(triplets, conf.R.rows() * order, conf.R.rows() * order);
+    }
 }
 
-SparseXd setHessianMatrix(const SparseXd& Q_bar, const SparseXd& R_bar, const SparseXd& one, const MatrixXd& theta, int a, int n, int n_CV) {
+SparseXd setHessianMatrix(const SparseXd& Q_bar, const SparseXd& R_bar, const SparseXd& one, const MatrixXd& theta, 
+                            const std::vector<int>& rows, const ChannelMap& channels, int a, int n, int n_CV, int threads) {
     // G = 2 * [R_bar + 2 Theta^T Q_bar, Theta, -Theta^T Q_bar 1, Theta^T Q_bar 1
     //          -1^T Q_bar Theta, 1^T Q_bar 1, 0
     //          1^T Q_bar Theta, 0, 1^T Q_bar 1];
-    MatrixXd g = MatrixXd::Zero(n, n);
-    // First row:
-    g.block(0, 0, a, a) = 2 * theta.transpose() * Q_bar * theta + 2 * R_bar;
-    g.block(0, a, a, n_CV) = -theta.transpose() * Q_bar * one; 
-    g.block(0, a + n_CV, a, n_CV) = theta.transpose() * Q_bar * one; 
-    
-    // Second row: 
-    g.block(a, 0, n_CV, a) = -one.transpose() * Q_bar * theta;
-    g.block(a, a, n_CV, n_CV) = one.transpose() * Q_bar * one;
-
-    // Third row:
-    g.block(a + n_CV, 0, n_CV, a) = one.transpose() * Q_bar * theta;
-    g.block(a + n_CV, a + n_CV, n_CV, n_CV) = one.transpose() * Q_bar * one;
-    return 2 * g.sparseView();
+    // Structurally zero rows and zero channel blocks of Theta do not contribute to the Theta terms, and are skipped
+    // Only the upper triangle is assembled, as read by OSQP, and emitted column by column in CSC
+    ThreadPool pool(threads);
+    const VectorXd q = Q_bar.diagonal();
+    const MatrixXd theta_q_one = ThetaQOne(theta, q, rows, channels); // Theta^T Q_bar 1
+    MatrixXd theta_q_theta = ThetaQTheta(theta, q, rows, channels, pool);
+    theta_q_theta += R_bar;
+    const MatrixXd one_q_one = one.transpose() * Q_bar * one;
+
+    Eigen::VectorXi col_nnz(n);
+    for (int c = 0; c < n; c++) {
+        col_nnz(c) = (c < a) ? c + 1 : a + n_CV;
+    }
+    SparseXd G(n, n);
+    G.reserve(col_nnz);
+    // First column block:
+    InsertUpper(G, theta_q_theta, 0, 4);
+    // Second and third column block, -Theta^T Q_bar 1 and Theta^T Q_bar 1 above 1^T Q_bar 1
+    for (int slack = 0; slack < 2; slack++) {
+        const int offset = a + slack * n_CV;
+        const double sign = slack ? 2 : -2;
+        for (int c = 0; c < n_CV; c++) {
+            for (int r = 0; r < a; r++) {
+                if (theta_q_one(r, c) != 0) {
+                    G.insert(r, offset + c) = sign * theta_q_one(r, c);
+                }
+            }
+            for (int r = 0; r <= c; r++) {
+                if (one_q_one(r, c) != 0) {
+                    G.insert(offset + r, offset + c) = 2 * one_q_one(r, c);
+                }
+            }
+        }
+    }
+    G.makeCompressed();
+    return G;
 }
 
-void setGradientVector(VectorXd& q, FSRModel& fsr, const SparseXd& Q_bar, const SparseXd& one,
-                        const MatrixXd& ref, const MPCConfig& conf, int n, int k) {
+/**
+ * @brief Helper function. Rows of the tracking cost, the nonzero diagonal entries of Q_bar
+ * 
+ * @param Q_bar output tuning
+ * @return std::vector<int> ascending rows
+ */
+static std::vector<int> CostRows(const SparseXd& Q_bar) {
+    std::vector<int> rows;
+    const VectorXd q = Q_bar.diagonal();
+    for (int row = 0; row < q.rows(); row++) {
+        if (q(row) != 0) {
+            rows.push_back(row);
+        }
+    }
+    return rows;
+}
+
+GradientCache setGradientCache(const SparseXd& Q_bar, const SparseXd& one, const MatrixXd& theta, const MPCConfig& conf) {
+    // gradient = [4 Theta^T Q_bar; -2 1^T Q_bar; 2 1^T Q_bar], restricted to the columns of the cost rows
+    GradientCache cache;
+    cache.rows = CostRows(Q_bar);
+    const int a = theta.cols(), n_CV = one.cols(), n_q = cache.rows.size();
+    const VectorXd q = VectorXd(Q_bar.diagonal())(cache.rows);
+    const MatrixXd one_q = 2 * MatrixXd(one)(cache.rows, Eigen::all).transpose() * q.asDiagonal();
+
+    cache.gradient.resize(a + 2 * n_CV, n_q);
+    cache.gradient.topRows(a) = 4 * theta(cache.rows, Eigen::all).transpose() * q.asDiagonal();
+    cache.gradient.middleRows(a, n_CV) = -one_q;
+    cache.gradient.bottomRows(n_CV) = one_q;
+    cache.rho.resize(a + 2 * n_CV);
+    cache.rho << VectorXd::Zero(a), conf.RoH, conf.RoL;
+    cache.difference = VectorXd::Zero(n_q);
+    return cache;
+}
+
+template <typename Scalar>
+void setGradientVector(VectorXd& q, FSRModelT<Scalar>& fsr, GradientCache& cache, const MatrixXd& ref, int k) {
     // q = 2 * [2 Theta^T Q_bar (Lambda(k) - tau(k)),
     //          -1^T Q_bar (Lambda(k) - tau(k)) + rho_{h},
-    //          1^T Q_bar (Lambda(k) - tau(k)) + rho_{l}]
-    q.resize(n);
-    VectorXd tau = setTau(ref, fsr.getP(), fsr.getW(), fsr.getN_CV(), k);
-    VectorXd difference = fsr.getLambda() - tau; 
-
-    // Rows: 
-    VectorXd first = 4 * fsr.getTheta().transpose() * Q_bar * difference;
-    VectorXd second = -2 * one.transpose() * Q_bar * difference + conf.RoH;
-    VectorXd third = 2 * one.transpose() * Q_bar * difference + conf.RoL;
-    q << first, second, third;
+    //          1^T Q_bar (Lambda(k) - tau(k)) + rho_{l}], one GEMV with the cached matrix
+    const int size_y = fsr.getP() - fsr.getW(), W = fsr.getW();
+    for (int i = 0; i < int(cache.rows.size()); i++) { // tau(k), row p of CV block cv being ref(cv, k + W + p)
+        const int row = cache.rows[i];
+        cache.difference(i) = double(fsr.getLambda(row)) - ref(row / size_y, k + W + row % size_y);
+    }
+    q.noalias() = cache.gradient * cache.difference;
+    q += cache.rho;
 }
 
 /////////////////////////////
 /////// CONSTRAINTS /////////
 /////////////////////////////
 
-void setConstraintVectors(VectorXd& l, VectorXd& u, FSRModel& fsr, const VectorXd& c_l, const VectorXd& c_u, const MatrixXd& K_inv,
+template <typename Scalar>
+void setConstraintVectors(VectorXd& l, VectorXd& u, FSRModelT<Scalar>& fsr, const VectorXd& c_l, const VectorXd& c_u, 
                          const SparseXd& Gamma, int m, int a) {
     // Reset bounds:
     l = c_l;
     u = c_u;
 
-    UpdateBounds(l, fsr, K_inv, Gamma, m, a); // Update lower and upper bound
-    UpdateBounds(u, fsr, K_inv, Gamma, m, a);
+    UpdateBounds(l, fsr, Gamma, m, a); // Update lower and upper bound
+    UpdateBounds(u, fsr, Gamma, m, a);
 }
 
-SparseXd setConstraintMatrix(const SparseXd& one, const MatrixXd& theta, const MatrixXd& K_inv, int m, int n, int a, int n_CV) {
-    // A = [ I (axa),                0 (axn_CV),           0 (axn_CV)
-    //       K⁽⁻¹⁾ (axa),            0 (axn_CV),           0 (axn_CV)
-    //       Theta (n_CV*(P-W)xa), -1 (n_CV*(P-W)xn_CV), 0 (n_CV*(P-W)xn_CV)
-    //       Theta (n_CV*(P-W)xa),  0 (n_CV*(P-W)xn_CV),  1 (n_CV*(P-W)xn_CV)
+SparseXd setConstraintMatrix(const SparseXd& one, const MatrixXd& theta, const MatrixXd& basis, 
+                                const std::vector<int>& rows, int m, int n, int a, int n_MV, int n_CV) {
+    // A = [ L (dxa),                0 (dxn_CV),           0 (dxn_CV)
+    //       K⁽⁻¹⁾ L (dxa),          0 (dxn_CV),           0 (dxn_CV)
+    //       Theta (n_yxa), -1 (n_yxn_CV), 0 (n_yxn_CV)
+    //       Theta (n_yxa),  0 (n_yxn_CV),  1 (n_yxn_CV)
     //       0 (n_CVxa),             I (n_CVxn_CV),        0 (n_CVxn_CV)
     //       0 (n_CVxa),             0 (n_CVxn_CV),        I (n_CVxn_CV)]; 
-    MatrixXd dense = MatrixXd::Zero(m, n); 
-    int dim_theta = theta.rows();
-    MatrixXd In_cv = MatrixXd::Identity(n_CV, n_CV);
+    // Y rows are restricted to the n_y constraint rows of Theta, the movable rows in the constraint windows. L = I (d = a) unless the moves are Laguerre coordinates
+    // K⁽⁻¹⁾ is block diagonal over the MVs, hence K⁽⁻¹⁾ L only holds the lower triangular block of every MV when L = I
+    // Assembled from triplets, the nonzeros of the dense blocks and the one and identity blocks
+    const int dim_theta = rows.size();
+    const int d = basis.rows();
+    const MatrixXd theta_y = theta(rows, Eigen::all);
+    const Eigen::SparseMatrix<double, Eigen::RowMajor> one_rows = one; // Row access to the slack scaling of a Y row
+    Triplets triplets;
+    triplets.reserve(2 * basis.size() + 2 * theta_y.size() + 2 * one.nonZeros() + 2 * n_CV);
 
     // dU, U row
-    dense.block(0, 0, a, a) = MatrixXd::Identity(a, a);
-    dense.block(a, 0, a, a) = K_inv;
+    AppendBlock(triplets, basis, 0, 0);
+    AppendBlock(triplets, ApplyKInv(basis, n_MV), d, 0);
 
     // Y row
-    dense.block(2 * a, 0, dim_theta, a) = theta;
-    dense.block(2 * a + dim_theta, 0, dim_theta, a) = theta;
-    dense.block(2 * a, a, dim_theta, n_CV) = -one;
-    dense.block(2 * a + dim_theta, a + n_CV, dim_theta, n_CV) = one;
+    AppendBlock(triplets, theta_y, 2 * d, 0);
+    AppendBlock(triplets, theta_y, 2 * d + dim_theta, 0);
+    for (int i = 0; i < dim_theta; i++) {
+        for (Eigen::SparseMatrix<double, Eigen::RowMajor>::InnerIterator it(one_rows, rows[i]); it; ++it) {
+            triplets.emplace_back(2 * d + i, a + it.col(), -it.value());
+            triplets.emplace_back(2 * d + dim_theta + i, a + n_CV + it.col(), it.value());
+        }
+    }
 
     // eta row
-    dense.block(2 * a + 2 * dim_theta, a, n_CV, n_CV) = In_cv;
-    dense.block(2 * a + 2 * dim_theta + n_CV, a + n_CV, n_CV, n_CV) = In_cv;
-    return dense.sparseView();
+    AppendIdentity(triplets, n_CV, 2 * d + 2 * dim_theta, a);
+    AppendIdentity(triplets, n_CV, 2 * d + 2 * dim_theta + n_CV, a + n_CV);
+    return FromTriplets(triplets, m, n);
 }
 
 VectorXd ConfigureConstraint(const VectorXd& z_pop, int m, int a, bool upper) {
@@ -207,7 +438,7 @@ VectorXd ConfigureConstraint(const VectorXd& z_pop, int m, int a, bool upper) {
     //          0/Inf (n_CV), 
     //          0/Inf (n_CV)] (m)
     VectorXd bound = VectorXd::Zero(m);
-    int duuy_size = z_pop.rows(); // = 2 * M * n_MV + (P-W) * n_CV = 2 * a + (P-W) * n_CV
+    int duuy_size = z_pop.rows(); // = 2 * M * n_MV + n_y = 2 * a + n_y
 
     if (upper) {
         bound.block(0, 0, duuy_size, 1) = z_pop;
@@ -215,7 +446,7 @@ VectorXd ConfigureConstraint(const VectorXd& z_pop, int m, int a, bool upper) {
         bound.block(duuy_size, 0, m - duuy_size, 1) = VectorXd::Constant(m - duuy_size, std::numeric_limits<double>::max()); 
     } else {
         // Extract lower Y constraints
-        VectorXd lower_y = z_pop(Eigen::seq(2 * a, Eigen::indexing::last)); // lower_y.rows() = (P-W) * n_CV
+        VectorXd lower_y = z_pop(Eigen::seq(2 * a, Eigen::indexing::last)); // lower_y.rows() = n_y
         // Set -Infinity values
         bound.block(2 * a, 0, lower_y.rows(), 1) = VectorXd::Constant(lower_y.rows(), std::numeric_limits<double>::min());
         bound.block(duuy_size, 0, lower_y.rows(), 1) = lower_y; // Set lower Y
@@ -224,41 +455,53 @@ VectorXd ConfigureConstraint(const VectorXd& z_pop, int m, int a, bool upper) {
     return bound;
 }
 
-MatrixXd setKInv(int a) { // Return by value
-    MatrixXd K_inv = MatrixXd::Constant(a, a, 1);
-    return K_inv.triangularView<Eigen::Lower>();
+MatrixXd ApplyKInv(const MatrixXd& x, int n_MV) {
+    // K⁽⁻¹⁾ = blkdiag(K_1⁽⁻¹⁾, ..., K_nMV⁽⁻¹⁾), K_j⁽⁻¹⁾ lower triangular ones: prefix sums within the rows of every MV, O(rows) per column
+    const int moves = x.rows() / n_MV;
+    MatrixXd sum = x;
+    for (int j = 0; j < n_MV; j++) {
+        for (int r = j * moves + 1; r < (j + 1) * moves; r++) {
+            sum.row(r) += sum.row(r - 1);
+        }
+    }
+    return sum;
 }
 
 SparseXd setGamma(int M, int n_MV) {
-    SparseXd gamma;
-    MatrixXd gamma_arg = MatrixXd::Zero(M, 1);
-    gamma_arg(0, 0) = 1.0;
-    blkdiag(gamma, gamma_arg, n_MV);
-    return gamma;
+    // blkdiag of [1, 0, ..., 0]^T (M x 1), one nonzero per MV
+    Triplets triplets;
+    triplets.reserve(n_MV);
+    for (int i = 0; i < n_MV; i++) {
+        triplets.emplace_back(i * M, i, 1.0);
+    }
+    return FromTriplets(triplets, M * n_MV, n_MV);
 }
 
 SparseXd setOmegaU(int M, int n_MV) {
-    MatrixXd omega_dense = MatrixXd::Zero(n_MV, n_MV * M);
+    Triplets triplets;
+    triplets.reserve(n_MV);
     for (int i = 0; i < n_MV; i++) {
-        omega_dense(i, i * M) = 1;
+        triplets.emplace_back(i, i * M, 1.0);
     }
-    return omega_dense.sparseView();
+    return FromTriplets(triplets, n_MV, n_MV * M);
 }
 
-VectorXd PopulateConstraints(const VectorXd& c, const MPCConfig& conf, int a, int n_MV, int n_CV) { 
-    // z_pop = [ z - Delta U (M * N_MV), 
-    //           z - U (M * N_MV),
-    //           z - Y (P-W) * N_CV)]
+VectorXd PopulateConstraints(const VectorXd& c, const MPCConfig& conf, const std::vector<int>& rows, int a, int n_MV) { 
+    // z_pop = [ z - Delta U (n_b * N_MV), 
+    //           z - U (n_b * N_MV),
+    //           z - Y (n_y)]
+    // u is constant within a move block, hence du and u are constrained at the n_b block starts
     int size_y = conf.P - conf.W;
-    VectorXd z_pop(2 * conf.M * n_MV + size_y * n_CV);
+    int moves = a / n_MV;
+    VectorXd z_pop(2 * a + rows.size());
 
     for (int var = 0; var < 2 * n_MV; var++) { // Assuming same constraining, u, du if n_MV < n_CV
-        z_pop.block(var * conf.M, 0, conf.M, 1) = VectorXd::Constant(conf.M, c(var));
-    } // Fill n first constraints, du and u, 2 * M * N_MV
+        z_pop.block(var * moves, 0, moves, 1) = VectorXd::Constant(moves, c(var));
+    } // Fill n first constraints, du and u, 2 * n_b * N_MV
 
-    for (int var = 0; var < n_CV; var++) {
-        z_pop.block(2 * a + (var * size_y), 0, size_y, 1) = VectorXd::Constant(size_y, c(2 * n_MV + var));
-    } // Fill remaining constraints, y, (P-W) * N_CV
+    for (int i = 0; i < int(rows.size()); i++) {
+        z_pop(2 * a + i) = c(2 * n_MV + rows[i] / size_y);
+    } // Fill remaining constraints, y, constraint rows of (P-W) * N_CV
     return z_pop;
 } 
 
@@ -266,35 +509,65 @@ VectorXd PopulateConstraints(const VectorXd& c, const MPCConfig& conf, int a, in
 /// Condensed formulation without (Wo) slack constraints ///
 ////////////////////////////////////////////////////////////
 
-// n = M * n_MV = a
-// m = 2 * M * n_CV + (P-W) * n_CV = 2 * a + (P-W) * n_CV
-
-SparseXd setHessianMatrixWoSlack(const SparseXd& Q_bar, const SparseXd& R_bar, const MatrixXd& theta) {
-    // G_cd = 2 (Theta^T * Q_bar * Theta + R_bar)
-    MatrixXd g = theta.transpose() * Q_bar * theta + R_bar; 
-    return 2 * g.sparseView();
+// n = n_b * n_MV = a
+// m = 2 * d + n_y, d = a unless the moves are Laguerre coordinates
+
+SparseXd setHessianMatrixWoSlack(const SparseXd& Q_bar, const SparseXd& R_bar, const MatrixXd& theta, const std::vector<int>& rows,
+                                    const ChannelMap& channels, int threads) {
+    // G_cd = 2 (Theta^T * Q_bar * Theta + R_bar), skipping structurally zero rows and zero channel blocks of Theta. Upper triangle in CSC
+    ThreadPool pool(threads);
+    MatrixXd g = ThetaQTheta(theta, VectorXd(Q_bar.diagonal()), rows, channels, pool);
+    g += R_bar;
+    Eigen::VectorXi col_nnz = Eigen::VectorXi::LinSpaced(g.cols(), 1, g.cols());
+    SparseXd G(g.rows(), g.cols());
+    G.reserve(col_nnz);
+    InsertUpper(G, g, 0, 2);
+    G.makeCompressed();
+    return G;
 }
 
-void setGradientVectorWoSlack(VectorXd& q, FSRModel& fsr, const SparseXd& Q_bar, const MatrixXd& ref, int n, int k) {
-    q.resize(n);
-    VectorXd tau = setTau(ref, fsr.getP(), fsr.getW(), fsr.getN_CV(), k);
-    q = 2 * fsr.getTheta().transpose() * Q_bar * (fsr.getLambda() - tau);
+GradientCache setGradientCacheWoSlack(const SparseXd& Q_bar, const MatrixXd& theta) {
+    // gradient = 2 Theta^T Q_bar, restricted to the columns of the cost rows
+    GradientCache cache;
+    cache.rows = CostRows(Q_bar);
+    const VectorXd q = VectorXd(Q_bar.diagonal())(cache.rows);
+    cache.gradient = 2 * theta(cache.rows, Eigen::all).transpose() * q.asDiagonal();
+    cache.rho = VectorXd::Zero(theta.cols());
+    cache.difference = VectorXd::Zero(cache.rows.size());
+    return cache;
 }
 
-SparseXd setConstraintMatrixWoSlack(const MatrixXd& theta, const MatrixXd& K_inv, int m, int n, int n_CV) {
-    MatrixXd dense = MatrixXd::Zero(m, n); 
-    dense.block(0, 0, n, n) = MatrixXd::Identity(n, n);
-    dense.block(n, 0, n, n) = K_inv;
-    dense.block(2 * n, 0, m - 2 * n, n) = theta;
-    return dense.sparseView();
+SparseXd setConstraintMatrixWoSlack(const MatrixXd& theta, const MatrixXd& basis, const std::vector<int>& rows, 
+                                    int m, int n, int n_MV) {
+    const int d = basis.rows();
+    const MatrixXd theta_y = theta(rows, Eigen::all); // Constraint rows
+    Triplets triplets;
+    triplets.reserve(2 * basis.size() + theta_y.size());
+    AppendBlock(triplets, basis, 0, 0);
+    AppendBlock(triplets, ApplyKInv(basis, n_MV), d, 0);
+    AppendBlock(triplets, theta_y, 2 * d, 0);
+    return FromTriplets(triplets, m, n);
 }
 
-void setConstraintVectorsWoSlack(VectorXd& l, VectorXd& u, FSRModel& fsr, const VectorXd& c_l, const VectorXd& c_u, const MatrixXd& K_inv,
+template <typename Scalar>
+void setConstraintVectorsWoSlack(VectorXd& l, VectorXd& u, FSRModelT<Scalar>& fsr, const VectorXd& c_l, const VectorXd& c_u, 
                          const SparseXd& Gamma, int m, int n) {
     // Reset bounds:
     l = c_l;
     u = c_u;
 
-    UpdateBoundsWoSlack(l, fsr, K_inv, Gamma, m, n); // Update lower and upper bound
-    UpdateBoundsWoSlack(u, fsr, K_inv, Gamma, m, n);
+    UpdateBoundsWoSlack(l, fsr, Gamma, m, n); // Update lower and upper bound
+    UpdateBoundsWoSlack(u, fsr, Gamma, m, n);
 }
+
+// Per step functions, instantiated for every model precision
+template void setGradientVector(VectorXd&, FSRModelT<double>&, GradientCache&, const MatrixXd&, int);
+template void setGradientVector(VectorXd&, FSRModelT<float>&, GradientCache&, const MatrixXd&, int);
+template void setConstraintVectors(VectorXd&, VectorXd&, FSRModelT<double>&, const VectorXd&, const VectorXd&, 
+                                    const SparseXd&, int, int);
+template void setConstraintVectors(VectorXd&, VectorXd&, FSRModelT<float>&, const VectorXd&, const VectorXd&, 
+                                    const SparseXd&, int, int);
+template void setConstraintVectorsWoSlack(VectorXd&, VectorXd&, FSRModelT<double>&, const VectorXd&, const VectorXd&, 
+                                    const SparseXd&, int, int);
+template void setConstraintVectorsWoSlack(VectorXd&, VectorXd&, FSRModelT<float>&, const VectorXd&, const VectorXd&, 
+                                    const SparseXd&, int, int);
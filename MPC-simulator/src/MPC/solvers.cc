@@ -16,7 +16,8 @@
 #include <iostream>
 using SparseXd = Eigen::SparseMatrix<double>; 
 
-void SRSolver(int T, MatrixXd& u_mat, MatrixXd& y_pred, FSRModel& fsr, const MPCConfig& conf, const VectorXd& z_min, 
+template <typename Scalar>
+void SRSolver(int T, MatrixXd& u_mat, MatrixXd& y_pred, FSRModelT<Scalar>& fsr, const MPCConfig& conf, const VectorXd& z_min, 
              const VectorXd& z_max, const MatrixXd& ref) {         
     // Initialize solver:
     OsqpEigen::Solver solver;
@@ -24,12 +25,15 @@ void SRSolver(int T, MatrixXd& u_mat, MatrixXd& y_pred, FSRModel& fsr, const MPC
     solver.settings()->setVerbosity(false); // Disable printing
 
     // MPC Scenario variables: W == 0
-    const int P = fsr.getP(), M = fsr.getM(), n_MV = fsr.getN_MV(), n_CV = fsr.getN_CV(); 
+    const int P = fsr.getP(), M = fsr.getM(), n_b = fsr.getNumMoves(), n_MV = fsr.getN_MV(), n_CV = fsr.getN_CV(); 
     // Define QP sizes:
-    const int n = M * n_MV + 2 * n_CV; // #Optimization variables, dim(z_cd)
-    const int m = 2 * (M * n_MV + P * n_CV + n_CV); // #Constraints, dim(z_st)
-    const int a = M * n_MV; // dim(du)
-    const VectorXd z_max_pop = PopulateConstraints(z_max, conf, a, n_MV, n_CV), z_min_pop = PopulateConstraints(z_min, conf, a, n_MV, n_CV);
+    const MatrixXd basis = fsr.getMoveBasis().template cast<double>(); // Constrained moves du = basis * z
+    const int d = basis.rows(); // Constrained moves, d = a unless the moves are Laguerre coordinates
+    const int n = n_b * n_MV + 2 * n_CV; // #Optimization variables, dim(z_cd)
+    const std::vector<int>& rows = fsr.getConstraintRows(); // Constrained Y rows du can move, n_y <= P * n_CV
+    const int m = 2 * (d + int(rows.size()) + n_CV); // #Constraints, dim(z_st)
+    const int a = n_b * n_MV; // dim(du), one move per block
+    const VectorXd z_max_pop = PopulateConstraints(z_max, conf, rows, d, n_MV), z_min_pop = PopulateConstraints(z_min, conf, rows, d, n_MV);
     // z_min_max_pop are respectively lower and upper populated constraints
 
     solver.data()->setNumberOfVariables(n);
@@ -37,18 +41,19 @@ void SRSolver(int T, MatrixXd& u_mat, MatrixXd& y_pred, FSRModel& fsr, const MPC
 
     // Define Cost function variables: 
     SparseXd Q_bar, R_bar;
-    const SparseXd Gamma = setGamma(M, n_MV), one = setOneMatrix(P, 0, n_CV);
-    const MatrixXd K_inv = setKInv(a), theta = fsr.getTheta();
+    const SparseXd Gamma = setGamma(d / n_MV, n_MV), one = setOneMatrix(P, 0, n_CV);
+    const MatrixXd theta = fsr.getTheta().template cast<double>();
     // Dynamic variables:
     VectorXd q, l = VectorXd::Zero(m), u = VectorXd::Zero(m); // l and u are lower and upper constraints, z_cd 
-    VectorXd c_l = ConfigureConstraint(z_min_pop, m, a, false), c_u = ConfigureConstraint(z_max_pop, m, a, true);
+    VectorXd c_l = ConfigureConstraint(z_min_pop, m, d, false), c_u = ConfigureConstraint(z_max_pop, m, d, true);
     
     // NB! W-dependant
     setWeightMatrices(Q_bar, R_bar, conf);
-    const SparseXd G = setHessianMatrix(Q_bar, R_bar, one, theta, a, n, n_CV);
-    const SparseXd A = setConstraintMatrix(one, theta, K_inv, m, n, a, n_CV);
-    setGradientVector(q, fsr, Q_bar, one, ref, conf, n, 0); // Initial gradient
-    setConstraintVectors(l, u, fsr, c_l, c_u, K_inv, Gamma, m, a);
+    const SparseXd G = setHessianMatrix(Q_bar, R_bar, one, theta, fsr.getCostRows(), fsr.getChannelMap(), a, n, n_CV, conf.threads);
+    const SparseXd A = setConstraintMatrix(one, theta, basis, rows, m, n, a, n_MV, n_CV);
+    GradientCache gradient = setGradientCache(Q_bar, one, theta, conf);
+    setGradientVector(q, fsr, gradient, ref, 0); // Initial gradient
+    setConstraintVectors(l, u, fsr, c_l, c_u, Gamma, m, d);
 
     if (!solver.data()->setHessianMatrix(G)) { throw std::runtime_error("Cannot initialize Hessian"); }
     if (!solver.data()->setGradient(q)) { throw std::runtime_error("Cannot initialize Gradient"); }
@@ -59,7 +64,7 @@ void SRSolver(int T, MatrixXd& u_mat, MatrixXd& y_pred, FSRModel& fsr, const MPC
 
     u_mat = MatrixXd::Zero(n_MV, T + M);
     y_pred = MatrixXd::Zero(n_CV, T + P + 1); // +1 Due to first prediction being y0
-    const SparseXd omega_u = setOmegaU(M, n_MV);
+    const SparseXd omega_u = (setOmegaU(d / n_MV, n_MV) * basis).sparseView(); // First move of every MV
 
     // MPC loop:
     for (int k = 0; k <= T; k++) { // Simulate one step more to get predictions.
@@ -69,20 +74,20 @@ void SRSolver(int T, MatrixXd& u_mat, MatrixXd& y_pred, FSRModel& fsr, const MPC
          // Claim solution:
          VectorXd z_st = solver.getSolution(); // [dU, eta_h, eta_l]
          VectorXd z = z_st(Eigen::seq(0, a - 1)); // [dU]
-         y_pred.col(k) = fsr.getY(z); // Store y_pred before update! 
+         y_pred.col(k) = fsr.getY(z.cast<Scalar>()).template cast<double>(); // Store y_pred before update! 
          
         if (k == T) { // Store predictons
-            u_mat.block(0, T, n_MV, M) = (K_inv * z).reshaped<Eigen::RowMajor>(n_MV, M).colwise() + u_mat.col(T-1);      
-            y_pred.block(0, T + 1, n_CV, P) = fsr.getY(z, true);
+            u_mat.block(0, T, n_MV, M) = ApplyKInv(fsr.ExpandMoves(z), n_MV).template reshaped<Eigen::RowMajor>(n_MV, M).colwise() + u_mat.col(T-1);      
+            y_pred.block(0, T + 1, n_CV, P) = fsr.getY(z.cast<Scalar>(), true).template cast<double>();
         } else {
             // Propagate FSR model:
             VectorXd du = omega_u * z; // MPC actuation
-            fsr.UpdateU(du);
-            u_mat.col(k) = fsr.getUK();
+            fsr.UpdateU(du.cast<Scalar>());
+            u_mat.col(k) = fsr.getUK().template cast<double>();
 
             // Update MPC problem:
-            setConstraintVectors(l, u, fsr, c_l, c_u, K_inv, Gamma, m, a);
-            setGradientVector(q, fsr, Q_bar, one, ref, conf, n, k); 
+            setConstraintVectors(l, u, fsr, c_l, c_u, Gamma, m, d);
+            setGradientVector(q, fsr, gradient, ref, k); 
 
             // Check if bounds are valid:
             if (!solver.updateBounds(l, u)) { throw std::runtime_error("Cannot update bounds"); }
@@ -91,7 +96,8 @@ void SRSolver(int T, MatrixXd& u_mat, MatrixXd& y_pred, FSRModel& fsr, const MPC
     }
 }
 
-void SRSolver(int T, MatrixXd& u_mat, MatrixXd& y_pred, FSRModel& fsr_sim, FSRModel& fsr_cost, const MPCConfig& conf, const VectorXd& z_min, 
+template <typename Scalar>
+void SRSolver(int T, MatrixXd& u_mat, MatrixXd& y_pred, FSRModelT<Scalar>& fsr_sim, FSRModelT<Scalar>& fsr_cost, const MPCConfig& conf, const VectorXd& z_min, 
              const VectorXd& z_max, const MatrixXd& ref) {
     // Initialize solver:
     OsqpEigen::Solver solver;
@@ -99,12 +105,15 @@ void SRSolver(int T, MatrixXd& u_mat, MatrixXd& y_pred, FSRModel& fsr_sim, FSRMo
     solver.settings()->setVerbosity(false); // Disable printing
 
     // MPC Scenario variables:
-    const int P = fsr_cost.getP(), M = fsr_cost.getM(), W = fsr_cost.getW(), n_MV = fsr_cost.getN_MV(), n_CV = fsr_cost.getN_CV(); 
+    const int P = fsr_cost.getP(), M = fsr_cost.getM(), n_b = fsr_cost.getNumMoves(), W = fsr_cost.getW(), n_MV = fsr_cost.getN_MV(), n_CV = fsr_cost.getN_CV(); 
     // Define QP sizes:
-    const int n = M * n_MV + 2 * n_CV; // #Optimization variables, dim(z_cd)
-    const int m = 2 * (M * n_MV + (P-W) * n_CV + n_CV); // #Constraints, dim(z_st)
-    const int a = M * n_MV; // dim(du)
-    const VectorXd z_max_pop = PopulateConstraints(z_max, conf, a, n_MV, n_CV), z_min_pop = PopulateConstraints(z_min, conf, a, n_MV, n_CV);
+    const MatrixXd basis = fsr_cost.getMoveBasis().template cast<double>(); // Constrained moves du = basis * z
+    const int d = basis.rows(); // Constrained moves, d = a unless the moves are Laguerre coordinates
+    const int n = n_b * n_MV + 2 * n_CV; // #Optimization variables, dim(z_cd)
+    const std::vector<int>& rows = fsr_cost.getConstraintRows(); // Constrained Y rows du can move, n_y <= (P-W) * n_CV
+    const int m = 2 * (d + int(rows.size()) + n_CV); // #Constraints, dim(z_st)
+    const int a = n_b * n_MV; // dim(du), one move per block
+    const VectorXd z_max_pop = PopulateConstraints(z_max, conf, rows, d, n_MV), z_min_pop = PopulateConstraints(z_min, conf, rows, d, n_MV);
     // z_min_max_pop are respectively lower and upper populated constraints
 
     solver.data()->setNumberOfVariables(n);
@@ -112,18 +121,19 @@ void SRSolver(int T, MatrixXd& u_mat, MatrixXd& y_pred, FSRModel& fsr_sim, FSRMo
 
     // Define Cost function variables: 
     SparseXd Q_bar, R_bar;
-    const SparseXd Gamma = setGamma(M, n_MV), one = setOneMatrix(P, W, n_CV);
-    const MatrixXd K_inv = setKInv(a), theta = fsr_cost.getTheta();
+    const SparseXd Gamma = setGamma(d / n_MV, n_MV), one = setOneMatrix(P, W, n_CV);
+    const MatrixXd theta = fsr_cost.getTheta().template cast<double>();
     // Dynamic variables:
     VectorXd q, l = VectorXd::Zero(m), u = VectorXd::Zero(m); // l and u are lower and upper constraints, z_cd 
-    VectorXd c_l = ConfigureConstraint(z_min_pop, m, a, false), c_u = ConfigureConstraint(z_max_pop, m, a, true);
+    VectorXd c_l = ConfigureConstraint(z_min_pop, m, d, false), c_u = ConfigureConstraint(z_max_pop, m, d, true);
 
     // NB! W-dependant
     setWeightMatrices(Q_bar, R_bar, conf);
-    const SparseXd G = setHessianMatrix(Q_bar, R_bar, one, theta, a, n, n_CV);
-    const SparseXd A = setConstraintMatrix(one, theta, K_inv, m, n, a, n_CV);
-    setGradientVector(q, fsr_cost, Q_bar, one, ref, conf, n, 0); // Initial gradient
-    setConstraintVectors(l, u, fsr_cost, c_l, c_u, K_inv, Gamma, m, a);
+    const SparseXd G = setHessianMatrix(Q_bar, R_bar, one, theta, fsr_cost.getCostRows(), fsr_cost.getChannelMap(), a, n, n_CV, conf.threads);
+    const SparseXd A = setConstraintMatrix(one, theta, basis, rows, m, n, a, n_MV, n_CV);
+    GradientCache gradient = setGradientCache(Q_bar, one, theta, conf);
+    setGradientVector(q, fsr_cost, gradient, ref, 0); // Initial gradient
+    setConstraintVectors(l, u, fsr_cost, c_l, c_u, Gamma, m, d);
 
     if (!solver.data()->setHessianMatrix(G)) { throw std::runtime_error("Cannot initialize Hessian"); }
     if (!solver.data()->setGradient(q)) { throw std::runtime_error("Cannot initialize Gradient"); }
@@ -134,7 +144,7 @@ void SRSolver(int T, MatrixXd& u_mat, MatrixXd& y_pred, FSRModel& fsr_sim, FSRMo
 
     u_mat = MatrixXd::Zero(n_MV, T + M);
     y_pred = MatrixXd::Zero(n_CV, T + P + 1);
-    const SparseXd omega_u = setOmegaU(M, n_MV);
+    const SparseXd omega_u = (setOmegaU(d / n_MV, n_MV) * basis).sparseView(); // First move of every MV
 
     // MPC loop:
     for (int k = 0; k <= T; k++) { // Simulate one step more to get predictions.
@@ -144,22 +154,22 @@ void SRSolver(int T, MatrixXd& u_mat, MatrixXd& y_pred, FSRModel& fsr_sim, FSRMo
         // Claim solution:
         VectorXd z_st = solver.getSolution(); // [dU, eta_h, eta_l]
         VectorXd z = z_st(Eigen::seq(0, a - 1)); // [dU]
-        y_pred.col(k) = fsr_sim.getY(z);
+        y_pred.col(k) = fsr_sim.getY(z.cast<Scalar>()).template cast<double>();
 
         // Store optimal du and y_pref: Before update!
         if (k == T) {      
-            u_mat.block(0, T, n_MV, M) = (K_inv * z).reshaped<Eigen::RowMajor>(n_MV, M).colwise() + u_mat.col(T-1);       
-            y_pred.block(0, T + 1, n_CV, P) = fsr_sim.getY(z, true);
+            u_mat.block(0, T, n_MV, M) = ApplyKInv(fsr_cost.ExpandMoves(z), n_MV).template reshaped<Eigen::RowMajor>(n_MV, M).colwise() + u_mat.col(T-1);       
+            y_pred.block(0, T + 1, n_CV, P) = fsr_sim.getY(z.cast<Scalar>(), true).template cast<double>();
         } else {
             // Propagate FSR models: Update both! 
             VectorXd du = omega_u * z; // MPC actuation
-            fsr_sim.UpdateU(du);
-            fsr_cost.UpdateU(du);
-            u_mat.col(k) = fsr_sim.getUK();
+            fsr_sim.UpdateU(du.cast<Scalar>());
+            fsr_cost.UpdateU(du.cast<Scalar>());
+            u_mat.col(k) = fsr_sim.getUK().template cast<double>();
         
             // Update MPC problem:
-            setConstraintVectors(l, u, fsr_cost, c_l, c_u, K_inv, Gamma, m, a);
-            setGradientVector(q, fsr_cost, Q_bar, one, ref, conf, n, k); 
+            setConstraintVectors(l, u, fsr_cost, c_l, c_u, Gamma, m, d);
+            setGradientVector(q, fsr_cost, gradient, ref, k); 
 
             // Check if bounds are valid:
             if (!solver.updateBounds(l, u)) { throw std::runtime_error("Cannot update bounds"); }
@@ -168,7 +178,8 @@ void SRSolver(int T, MatrixXd& u_mat, MatrixXd& y_pred, FSRModel& fsr_sim, FSRMo
     }
 }
 
-void SRSolverWoSlack(int T, MatrixXd& u_mat, MatrixXd& y_pred, FSRModel& fsr, const MPCConfig& conf, const VectorXd& z_min, 
+template <typename Scalar>
+void SRSolverWoSlack(int T, MatrixXd& u_mat, MatrixXd& y_pred, FSRModelT<Scalar>& fsr, const MPCConfig& conf, const VectorXd& z_min, 
              const VectorXd& z_max, const MatrixXd& ref) {
     // Initialize solver:
     OsqpEigen::Solver solver;
@@ -176,28 +187,32 @@ void SRSolverWoSlack(int T, MatrixXd& u_mat, MatrixXd& y_pred, FSRModel& fsr, co
     solver.settings()->setVerbosity(false); // Disable printing
 
     // MPC Scenario variables: W == 0
-    const int P = fsr.getP(), M = fsr.getM(), n_MV = fsr.getN_MV(), n_CV = fsr.getN_CV(); 
+    const int P = fsr.getP(), M = fsr.getM(), n_b = fsr.getNumMoves(), n_MV = fsr.getN_MV(), n_CV = fsr.getN_CV(); 
     // Define QP sizes:
-    const int n = M * n_MV; // #Optimization variables, dim(z_cd) = a 
-    const int m = 2 * M * n_MV + P * n_CV; // #Constraints, dim(z_st)
-    const VectorXd c_u = PopulateConstraints(z_max, conf, n, n_MV, n_CV), c_l = PopulateConstraints(z_min, conf, n, n_MV, n_CV);
+    const MatrixXd basis = fsr.getMoveBasis().template cast<double>(); // Constrained moves du = basis * z
+    const int d = basis.rows(); // Constrained moves, d = n unless the moves are Laguerre coordinates
+    const int n = n_b * n_MV; // #Optimization variables, dim(z_cd) = a 
+    const std::vector<int>& rows = fsr.getConstraintRows(); // Constrained Y rows du can move, n_y <= P * n_CV
+    const int m = 2 * d + int(rows.size()); // #Constraints, dim(z_st)
+    const VectorXd c_u = PopulateConstraints(z_max, conf, rows, d, n_MV), c_l = PopulateConstraints(z_min, conf, rows, d, n_MV);
     // c_* are respectively lower and upper populated constraints
 
     solver.data()->setNumberOfVariables(n);
     solver.data()->setNumberOfConstraints(m);
 
     // Define Cost function variables: 
-    SparseXd Q_bar, R_bar, Gamma = setGamma(M, n_MV), one = setOneMatrix(P, 0, n_CV);
-    const MatrixXd K_inv = setKInv(n), theta = fsr.getTheta();
+    SparseXd Q_bar, R_bar, Gamma = setGamma(d / n_MV, n_MV), one = setOneMatrix(P, 0, n_CV);
+    const MatrixXd theta = fsr.getTheta().template cast<double>();
     // Dynamic variables:
     VectorXd q, l = VectorXd::Zero(m), u = VectorXd::Zero(m); // l and u are lower and upper constraints, z_cd 
 
     // NB! W-dependant
     setWeightMatrices(Q_bar, R_bar, conf);
-    SparseXd G = setHessianMatrixWoSlack(Q_bar, R_bar, theta);
-    setGradientVectorWoSlack(q, fsr, Q_bar, ref, n, 0); // Initial gradient
-    SparseXd A = setConstraintMatrixWoSlack(theta, K_inv, m, n, n_CV);
-    setConstraintVectorsWoSlack(l, u, fsr, c_l, c_u, K_inv, Gamma, m, n);
+    SparseXd G = setHessianMatrixWoSlack(Q_bar, R_bar, theta, fsr.getCostRows(), fsr.getChannelMap(), conf.threads);
+    GradientCache gradient = setGradientCacheWoSlack(Q_bar, theta);
+    setGradientVector(q, fsr, gradient, ref, 0); // Initial gradient
+    SparseXd A = setConstraintMatrixWoSlack(theta, basis, rows, m, n, n_MV);
+    setConstraintVectorsWoSlack(l, u, fsr, c_l, c_u, Gamma, m, d);
 
     if (!solver.data()->setHessianMatrix(G)) { throw std::runtime_error("Cannot initialize Hessian"); }
     if (!solver.data()->setGradient(q)) { throw std::runtime_error("Cannot initialize Gradient"); }
@@ -208,7 +223,7 @@ void SRSolverWoSlack(int T, MatrixXd& u_mat, MatrixXd& y_pred, FSRModel& fsr, co
 
     u_mat = MatrixXd::Zero(n_MV, T + M);
     y_pred = MatrixXd::Zero(n_CV, T + P + 1);
-    const SparseXd omega_u = setOmegaU(M, n_MV);
+    const SparseXd omega_u = (setOmegaU(d / n_MV, n_MV) * basis).sparseView(); // First move of every MV
 
     // MPC loop:
     for (int k = 0; k <= T; k++) { // Simulate one step more to get predictions.
@@ -218,20 +233,20 @@ void SRSolverWoSlack(int T, MatrixXd& u_mat, MatrixXd& y_pred, FSRModel& fsr, co
          // Claim solution:
          VectorXd z_st = solver.getSolution(); // [dU, eta_h, eta_l]
          VectorXd z = z_st(Eigen::seq(0, n - 1)); // [dU]
-         y_pred.col(k) = fsr.getY(z);
+         y_pred.col(k) = fsr.getY(z.cast<Scalar>()).template cast<double>();
          
         if (k == T) { // Store predictons
-            u_mat.block(0, T, n_MV, M) = (K_inv * z).reshaped<Eigen::RowMajor>(n_MV, M).colwise() + u_mat.col(T-1);      
-            y_pred.block(0, T + 1, n_CV, P) = fsr.getY(z, true);
+            u_mat.block(0, T, n_MV, M) = ApplyKInv(fsr.ExpandMoves(z), n_MV).template reshaped<Eigen::RowMajor>(n_MV, M).colwise() + u_mat.col(T-1);      
+            y_pred.block(0, T + 1, n_CV, P) = fsr.getY(z.cast<Scalar>(), true).template cast<double>();
         } else {
             // Propagate FSR model:
             VectorXd du = omega_u * z; // MPC actuation
-            fsr.UpdateU(du);
-            u_mat.col(k) = fsr.getUK();
+            fsr.UpdateU(du.cast<Scalar>());
+            u_mat.col(k) = fsr.getUK().template cast<double>();
 
             // Update MPC problem:
-            setConstraintVectorsWoSlack(l, u, fsr, c_l, c_u, K_inv, Gamma, m, n);
-            setGradientVectorWoSlack(q, fsr, Q_bar, ref, n, k); 
+            setConstraintVectorsWoSlack(l, u, fsr, c_l, c_u, Gamma, m, d);
+            setGradientVector(q, fsr, gradient, ref, k); 
 
             // Check if bounds are valid:
             if (!solver.updateBounds(l, u)) { throw std::runtime_error("Cannot update bounds"); }
@@ -240,7 +255,8 @@ void SRSolverWoSlack(int T, MatrixXd& u_mat, MatrixXd& y_pred, FSRModel& fsr, co
     }
 }
 
-void SRSolverWoSlack(int T, MatrixXd& u_mat, MatrixXd& y_pred, FSRModel& fsr_sim, FSRModel& fsr_cost, const MPCConfig& conf, const VectorXd& z_min, 
+template <typename Scalar>
+void SRSolverWoSlack(int T, MatrixXd& u_mat, MatrixXd& y_pred, FSRModelT<Scalar>& fsr_sim, FSRModelT<Scalar>& fsr_cost, const MPCConfig& conf, const VectorXd& z_min, 
              const VectorXd& z_max, const MatrixXd& ref) {  
     // Initialize solver:
     OsqpEigen::Solver solver;
@@ -248,11 +264,14 @@ void SRSolverWoSlack(int T, MatrixXd& u_mat, MatrixXd& y_pred, FSRModel& fsr_sim
     solver.settings()->setVerbosity(false); // Disable printing
 
     // MPC Scenario variables:
-    const int P = fsr_cost.getP(), M = fsr_cost.getM(), W = fsr_cost.getW(), n_MV = fsr_cost.getN_MV(), n_CV = fsr_cost.getN_CV(); 
+    const int P = fsr_cost.getP(), M = fsr_cost.getM(), n_b = fsr_cost.getNumMoves(), W = fsr_cost.getW(), n_MV = fsr_cost.getN_MV(), n_CV = fsr_cost.getN_CV(); 
     // Define QP sizes:
-    const int n = M * n_MV; // #Optimization variables, dim(z_cd) = a 
-    const int m = 2 * M * n_MV + (P-W) * n_CV; // #Constraints, dim(z_st)
-    const VectorXd c_u = PopulateConstraints(z_max, conf, n, n_MV, n_CV), c_l = PopulateConstraints(z_min, conf, n, n_MV, n_CV);
+    const MatrixXd basis = fsr_cost.getMoveBasis().template cast<double>(); // Constrained moves du = basis * z
+    const int d = basis.rows(); // Constrained moves, d = n unless the moves are Laguerre coordinates
+    const int n = n_b * n_MV; // #Optimization variables, dim(z_cd) = a 
+    const std::vector<int>& rows = fsr_cost.getConstraintRows(); // Constrained Y rows du can move, n_y <= (P-W) * n_CV
+    const int m = 2 * d + int(rows.size()); // #Constraints, dim(z_st)
+    const VectorXd c_u = PopulateConstraints(z_max, conf, rows, d, n_MV), c_l = PopulateConstraints(z_min, conf, rows, d, n_MV);
     // c_* are respectively lower and upper populated constraints
 
     solver.data()->setNumberOfVariables(n);
@@ -260,17 +279,18 @@ void SRSolverWoSlack(int T, MatrixXd& u_mat, MatrixXd& y_pred, FSRModel& fsr_sim
 
     // Define Cost function variables: 
     SparseXd Q_bar, R_bar;
-    const SparseXd Gamma = setGamma(M, n_MV), one = setOneMatrix(P, W, n_CV);
-    const MatrixXd K_inv = setKInv(n), theta = fsr_cost.getTheta();
+    const SparseXd Gamma = setGamma(d / n_MV, n_MV), one = setOneMatrix(P, W, n_CV);
+    const MatrixXd theta = fsr_cost.getTheta().template cast<double>();
     // Dynamic variables:
     VectorXd q, l = VectorXd::Zero(m), u = VectorXd::Zero(m); // l and u are lower and upper constraints, z_cd 
 
     // NB! W-dependant
     setWeightMatrices(Q_bar, R_bar, conf);
-    SparseXd G = setHessianMatrixWoSlack(Q_bar, R_bar, theta);
-    SparseXd A = setConstraintMatrixWoSlack(theta, K_inv, m, n, n_CV);
-    setGradientVectorWoSlack(q, fsr_cost, Q_bar, ref, n, 0); // Initial gradient
-    setConstraintVectorsWoSlack(l, u, fsr_cost, c_l, c_u, K_inv, Gamma, m, n);
+    SparseXd G = setHessianMatrixWoSlack(Q_bar, R_bar, theta, fsr_cost.getCostRows(), fsr_cost.getChannelMap(), conf.threads);
+    SparseXd A = setConstraintMatrixWoSlack(theta, basis, rows, m, n, n_MV);
+    GradientCache gradient = setGradientCacheWoSlack(Q_bar, theta);
+    setGradientVector(q, fsr_cost, gradient, ref, 0); // Initial gradient
+    setConstraintVectorsWoSlack(l, u, fsr_cost, c_l, c_u, Gamma, m, d);
 
     if (!solver.data()->setHessianMatrix(G)) { throw std::runtime_error("Cannot initialize Hessian"); }
     if (!solver.data()->setGradient(q)) { throw std::runtime_error("Cannot initialize Gradient"); }
@@ -281,7 +301,7 @@ void SRSolverWoSlack(int T, MatrixXd& u_mat, MatrixXd& y_pred, FSRModel& fsr_sim
 
     u_mat = MatrixXd::Zero(n_MV, T + M);
     y_pred = MatrixXd::Zero(n_CV, T + P + 1);
-    const SparseXd omega_u = setOmegaU(M, n_MV);
+    const SparseXd omega_u = (setOmegaU(d / n_MV, n_MV) * basis).sparseView(); // First move of every MV
 
     // MPC loop:
     for (int k = 0; k <= T; k++) { // Simulate one step more to get predictions.
@@ -291,26 +311,42 @@ void SRSolverWoSlack(int T, MatrixXd& u_mat, MatrixXd& y_pred, FSRModel& fsr_sim
         // Claim solution:
         VectorXd z_st = solver.getSolution(); // [dU, eta_h, eta_l]
         VectorXd z = z_st(Eigen::seq(0, n - 1)); // [dU]
-        y_pred.col(k) = fsr_sim.getY(z); // Store y_pred:
+        y_pred.col(k) = fsr_sim.getY(z.cast<Scalar>()).template cast<double>(); // Store y_pred:
 
         // Store optimal du and y_pref: Before update!
         if (k == T) {      
-            u_mat.block(0, T, n_MV, M) = (K_inv * z).reshaped<Eigen::RowMajor>(n_MV, M).colwise() + u_mat.col(T-1);       
-            y_pred.block(0, T + 1, n_CV, P) = fsr_sim.getY(z, true);
+            u_mat.block(0, T, n_MV, M) = ApplyKInv(fsr_cost.ExpandMoves(z), n_MV).template reshaped<Eigen::RowMajor>(n_MV, M).colwise() + u_mat.col(T-1);       
+            y_pred.block(0, T + 1, n_CV, P) = fsr_sim.getY(z.cast<Scalar>(), true).template cast<double>();
         } else {
             // Propagate FSR models: Update both! 
             VectorXd du = omega_u * z; // MPC actuation
-            fsr_sim.UpdateU(du);
-            fsr_cost.UpdateU(du);
-            u_mat.col(k) = fsr_sim.getUK();
+            fsr_sim.UpdateU(du.cast<Scalar>());
+            fsr_cost.UpdateU(du.cast<Scalar>());
+            u_mat.col(k) = fsr_sim.getUK().template cast<double>();
         
             // Update MPC problem:
-            setConstraintVectorsWoSlack(l, u, fsr_cost, c_l, c_u, K_inv, Gamma, m, n);
-            setGradientVectorWoSlack(q, fsr_cost, Q_bar, ref, n, k); 
+            setConstraintVectorsWoSlack(l, u, fsr_cost, c_l, c_u, Gamma, m, d);
+            setGradientVector(q, fsr_cost, gradient, ref, k); 
 
             // Check if bounds are valid:
             if (!solver.updateBounds(l, u)) { throw std::runtime_error("Cannot update bounds"); }
             if (!solver.updateGradient(q)) { throw std::runtime_error("Cannot update gradient"); }
         }
     }
-}
\ No newline at end of file
+}
+
+// Solvers, instantiated for every model precision
+template void SRSolver(int, MatrixXd&, MatrixXd&, FSRModelT<double>&, const MPCConfig&, const VectorXd&, const VectorXd&, const MatrixXd&);
+template void SRSolver(int, MatrixXd&, MatrixXd&, FSRModelT<float>&, const MPCConfig&, const VectorXd&, const VectorXd&, const MatrixXd&);
+template void SRSolver(int, MatrixXd&, MatrixXd&, FSRModelT<double>&, FSRModelT<double>&, const MPCConfig&, const VectorXd&, 
+                        const VectorXd&, const MatrixXd&);
+template void SRSolver(int, MatrixXd&, MatrixXd&, FSRModelT<float>&, FSRModelT<float>&, const MPCConfig&, const VectorXd&, 
+                        const VectorXd&, const MatrixXd&);
+template void SRSolverWoSlack(int, MatrixXd&, MatrixXd&, FSRModelT<double>&, const MPCConfig&, const VectorXd&, const VectorXd&, 
+                        const MatrixXd&);
+template void SRSolverWoSlack(int, MatrixXd&, MatrixXd&, FSRModelT<float>&, const MPCConfig&, const VectorXd&, const VectorXd&, 
+                        const MatrixXd&);
+template void SRSolverWoSlack(int, MatrixXd&, MatrixXd&, FSRModelT<double>&, FSRModelT<double>&, const MPCConfig&, const VectorXd&, 
+                        const VectorXd&, const MatrixXd&);
+template void SRSolverWoSlack(int, MatrixXd&, MatrixXd&, FSRModelT<float>&, FSRModelT<float>&, const MPCConfig&, const VectorXd&, 
+                        const VectorXd&, const MatrixXd&);
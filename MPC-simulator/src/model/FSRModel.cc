@@ -7,200 +7,417 @@
 #include "model/FSRModel.h"
 #include "IO/json_specifiers.h"
 
-FSRModel::FSRModel(VectorXd** SR, std::map<string, int> m_param, const MPCConfig& conf,
+#include <cmath>
+#include <cassert>
+#include <stdexcept>
+
+MatrixXd LaguerreBasis(int M, int order, double pole) {
+    // A_l = [a, 0, ..., 0; beta, a, ..., 0; -a beta, beta, a, ...; ...], beta = 1 - a^2
+    const double beta = 1 - pole * pole;
+    MatrixXd A_l = MatrixXd::Zero(order, order);
+    VectorXd L = VectorXd::Zero(order);
+    for (int i = 0; i < order; i++) {
+        A_l(i, i) = pole;
+        for (int j = 0; j < i; j++) {
+            A_l(i, j) = std::pow(-pole, i - j - 1) * beta;
+        }
+        L(i) = std::sqrt(beta) * std::pow(-pole, i);
+    }
+    MatrixXd basis(M, order);
+    for (int k = 0; k < M; k++) {
+        basis.row(k) = L.transpose();
+        L = A_l * L;
+    }
+    return basis;
+}
+
+template <typename Scalar>
+FSRModelT<Scalar>::FSRModelT(TensorPtr SR, std::map<string, int> m_param, const MPCConfig& conf,
                    const std::vector<double>& init_u, const std::vector<double>& init_y) :
-                      P_{conf.P}, M_{conf.M}, W_{conf.W} {
+                      P_{conf.P}, M_{conf.M}, W_{conf.W}, n_threads_{conf.threads}, head_{0}, SR_{std::move(SR)} {
     n_CV_ = m_param[kN_CV];
     n_MV_ = m_param[kN_MV];  
     N_ = m_param[kN];
 
-    u_K_ = VectorXd::Map(init_u.data(), init_u.size());
-    u_ = VectorXd::Map(init_u.data(), init_u.size());
+    u_K_ = VectorXd::Map(init_u.data(), init_u.size()).template cast<Scalar>();
+    u_ = VectorXd::Map(init_u.data(), init_u.size()).template cast<Scalar>();
     y_ = setInitY(init_y, P_ - W_);
 
-    AllocateAndDeepCopy(SR); 
-    // Setting matrix member variables
-    setSRMatrix();
-    theta_ = getThetaMatrix(W_);
-    phi_ = getPhiMatrix(W_);
-    psi_ = getPsi(W_);
+    // Setting matrix member variables, channels are assembled in parallel
+    ThreadPool pool(n_threads_);
+    auto mat = std::make_shared<ModelMatrices>(); // Filled in place, read by the helpers through mat_
+    mat_ = mat;
+    mat->block_starts = conf.getBlockStarts();
+    if (conf.laguerre_order > 0) { // Same Laguerre network for every MV
+        const MatrixXs laguerre = LaguerreBasis(M_, conf.laguerre_order, conf.laguerre_pole).template cast<Scalar>();
+        mat->basis = MatrixXs::Zero(n_MV_ * M_, n_MV_ * conf.laguerre_order);
+        for (int j = 0; j < n_MV_; j++) {
+            mat->basis.block(j * M_, j * conf.laguerre_order, M_, conf.laguerre_order) = laguerre;
+        }
+    }
+    mat->theta = getThetaMatrix(W_, pool);
+    mat->theta_op = ThetaOperatorT<Scalar>(SR_, P_, M_, W_, ThetaKernel::AUTO, &pool);
+    mat->kernel = isBlocked() ? nullptr : MakeFixedKernel(*SR_, mat->theta, P_, M_, W_);
+    if (mat->basis.size()) { // Theta * basis, precomputed once. The blocks of every MV remain channel blocks
+        mat->theta = mat->theta * mat->basis;
+    } else if (isBlocked()) { // Theta * E, E expanding the blocked moves, holds the block start columns of Theta
+        std::vector<int> columns;
+        for (int j = 0; j < n_MV_; j++) {
+            for (int start : mat->block_starts) {
+                columns.push_back(j * M_ + start);
+            }
+        }
+        mat->theta = MatrixXs(mat->theta(Eigen::all, columns));
+    }
+    mat->psi = getPsi(W_, pool);
+    tail_ = VectorXs::Zero(n_CV_);
+    mat->movable_rows = setMovableRows();
+    mat->cost_rows = mat->movable_rows;
+    if (!conf.coincidence_points.empty()) { // Prediction step p is row p-W-1 of every CV block
+        const std::vector<int>& points = conf.coincidence_points;
+        mat->cost_rows.clear();
+        for (int row : mat->movable_rows) {
+            if (std::binary_search(points.begin(), points.end(), row % (P_ - W_) + W_ + 1)) {
+                mat->cost_rows.push_back(row);
+            }
+        }
+    }
+    for (int row : mat->movable_rows) {
+        if (conf.isConstrainedStep(row / (P_ - W_), row % (P_ - W_) + W_ + 1)) {
+            mat->constraint_rows.push_back(row);
+        }
+    }
 
-    B_ = VectorXd::Zero((P_ - W_) * n_CV_);
-    du_tilde_mat_ = MatrixXd::Zero(n_MV_, N_-W_-1);  
+    B_ = VectorXs::Zero((P_ - W_) * n_CV_);
+    du_tilde_mat_ = MatrixXs::Zero(n_MV_, N_-W_-1);  
+    lambda_ = getFreeResponse();
 }
 
-FSRModel::FSRModel(VectorXd** SR, std::map<std::string, int> m_param, const std::vector<double>& init_u, 
-            const std::vector<double>& init_y) : P_{1}, M_{1}, W_{0} {
+template <typename Scalar>
+FSRModelT<Scalar>::FSRModelT(TensorPtr SR, std::map<std::string, int> m_param, const std::vector<double>& init_u, 
+            const std::vector<double>& init_y) : P_{1}, M_{1}, W_{0}, n_threads_{1}, head_{0}, SR_{std::move(SR)} {
     n_CV_ = m_param[kN_CV];
     n_MV_ = m_param[kN_MV];  
     N_ = m_param[kN];
 
-    u_K_ = VectorXd::Map(init_u.data(), init_u.size()); 
-    u_ = VectorXd::Map(init_u.data(), init_u.size());
-    y_ = VectorXd::Map(init_y.data(), init_y.size());
+    u_K_ = VectorXd::Map(init_u.data(), init_u.size()).template cast<Scalar>(); 
+    u_ = VectorXd::Map(init_u.data(), init_u.size()).template cast<Scalar>();
+    y_ = VectorXd::Map(init_y.data(), init_y.size()).template cast<Scalar>();
 
-    AllocateAndDeepCopy(SR); 
     // set FSRM matrix variables
-    setSRMatrix();
-    theta_ = getThetaMatrix(W_);
-    phi_ = getPhiMatrix(W_);
-    psi_ = getPsi(W_);
+    ThreadPool pool(n_threads_);
+    auto mat = std::make_shared<ModelMatrices>(); // Filled in place, read by the helpers through mat_
+    mat_ = mat;
+    mat->block_starts = {0};
+    mat->theta = getThetaMatrix(W_, pool);
+    mat->theta_op = ThetaOperatorT<Scalar>(SR_, P_, M_, W_, ThetaKernel::AUTO, &pool);
+    mat->kernel = MakeFixedKernel(*SR_, mat->theta, P_, M_, W_);
+    mat->psi = getPsi(W_, pool);
+    tail_ = VectorXs::Zero(n_CV_);
+    mat->movable_rows = setMovableRows();
+    mat->cost_rows = mat->movable_rows;
+    mat->constraint_rows = mat->movable_rows;
 
-    B_ = VectorXd::Zero((P_ - W_) * n_CV_);
-    du_tilde_mat_ = MatrixXd::Zero(n_MV_, N_-W_-1); 
+    B_ = VectorXs::Zero((P_ - W_) * n_CV_);
+    du_tilde_mat_ = MatrixXs::Zero(n_MV_, N_-W_-1); 
+    lambda_ = getFreeResponse();
 }    
 
-FSRModel::~FSRModel() {
-    if (n_CV_ != 0 && n_MV_ != 0) {
-        for (int i = 0 ; i < n_CV_; i++) {
-            delete[] pp_SR_vec_[i];
-            delete[] pp_SR_mat_[i];
-        }
-        delete[] pp_SR_vec_;
-        delete[] pp_SR_mat_;
-    }
-}
-
-void FSRModel::AllocateAndDeepCopy(VectorXd** SR) {
-    // Allocate memory
-    pp_SR_mat_ = new MatrixXd*[n_CV_];
-    for (int i = 0; i < n_CV_; ++i) {
-        pp_SR_mat_[i] = new MatrixXd[n_MV_];
-    }
-    for (int row = 0; row < n_CV_; row++) {
-        for (int col = 0; col < n_MV_; col++) {
-            pp_SR_mat_[row][col] = MatrixXd::Zero(P_, M_);
-        }
-    }
-    // Deep copy SR into pp_SR_vec
-    pp_SR_vec_ = new VectorXd*[n_CV_];
-    for (int i = 0; i < n_CV_; ++i) {
-        pp_SR_vec_[i] = new VectorXd[n_MV_];
-    }
-    for (int row = 0; row < n_CV_; row++) {
-        for (int col = 0; col < n_MV_; col++) {
-            pp_SR_vec_[row][col] = SR[row][col];
-        }
-    }
-}
-
-void FSRModel::setLowerTriangularMatrix(const VectorXd& pred_vec, MatrixXd& S) {
+template <typename Scalar>
+void FSRModelT<Scalar>::setLowerTriangularMatrix(const typename SRTensorT<Scalar>::ConstChannel& pred_vec, Scalar scale, Eigen::Ref<MatrixXs> S, int W) const {
     // S = [[ s1, 0, ..., 0 
     //        s2, s1, 0,  . 
     //         ., . ,  ., . 
     //         sM, sM-1, ..., s1
     //          ., ., ., . 
-    //         sP, sP-1, ..., sP-M]] (7b) in Light-weight MPC thesis
-    int n = 0; 
+    //         sP, sP-1, ..., sP-M]] (7b) in Light-weight MPC thesis, rows W to P
     for (int i = 0; i < M_; i++) {
-        for (int j = 0; j < P_-n; j++) {
-            S(j+n, i) = pred_vec(j);
-        }
-        n++;
-    }
-}
-
-void FSRModel::setSRMatrix() {
-    for (int i = 0; i < n_CV_; i++) {
-        MatrixXd S = MatrixXd::Zero(P_, M_);
-        for (int j = 0; j < n_MV_; j++) {
-            setLowerTriangularMatrix(pp_SR_vec_[i][j], S);
-            pp_SR_mat_[i][j] = S;
-        }
+        const int start = std::max(i - W, 0); // First nonzero row of column i
+        S.col(i).tail(P_-W-start) = scale * pred_vec.segment(W+start-i, P_-W-start);
     }
 }
 
-MatrixXd FSRModel::getThetaMatrix(int W) {
-    MatrixXd tmp_theta = MatrixXd::Zero(n_CV_*(P_-W), n_MV_*M_);
-    for (int i = 0; i < n_CV_; i++) {
-        for (int j = 0; j < n_MV_; j++) {
-            tmp_theta.block(i*(P_-W), j*M_, P_-W, M_) = pp_SR_mat_[i][j](Eigen::seq(W, Eigen::indexing::last), Eigen::seq(0, Eigen::indexing::last)); 
+template <typename Scalar>
+typename FSRModelT<Scalar>::MatrixXs FSRModelT<Scalar>::getThetaMatrix(int W, ThreadPool& pool) const {
+    MatrixXs tmp_theta = MatrixXs::Zero(n_CV_*(P_-W), n_MV_*M_);
+    pool.ParallelFor(n_CV_ * n_MV_, [&](int channel) { // Every channel writes a disjoint block
+        const int i = channel / n_MV_, j = channel % n_MV_;
+        if (!SR_->isNonzero(i, j)) { // Zero block
+            return;
         }
-    }
+        setLowerTriangularMatrix(SR_->getCanonical(i, j), SR_->getScale(i, j), tmp_theta.block(i*(P_-W), j*M_, P_-W, M_), W);
+    });
     return tmp_theta; 
 }
 
-MatrixXd FSRModel::getPhiMatrix(int W) {
-    MatrixXd tmp_phi = MatrixXd::Zero(n_CV_*(P_-W), n_MV_*(N_-W-1));
-    for (int i = 0; i < n_CV_; i++) {
-        for (int j = 0; j < n_MV_; j++) { 
-            double sn = pp_SR_vec_[i][j](Eigen::indexing::last); // S(N)
-            for (int pad = 0; pad < (P_-W); pad++) {
-                // Slicing prior s-coefficients
-                VectorXd vec = pp_SR_vec_[i][j](Eigen::seq(W + pad, Eigen::indexing::last - 1)); // Accessing [S(W+k), ..., S(N-1)]
-                VectorXd pad_vec = PadVec(vec, pad, sn); // pad_vec.rows() = N-W-1
-                int size = pad_vec.rows(); 
-                
-                // Write to phi-matrix
-                tmp_phi((i * (P_-W)) + pad, Eigen::seq(j * size, (j+1) * size - 1)) = pad_vec.transpose();
-            }
+template <typename Scalar>
+typename FSRModelT<Scalar>::MatrixXs FSRModelT<Scalar>::getPhiMatrix(int W, ThreadPool& pool) const {
+    const int size = N_-W-1;
+    MatrixXs tmp_phi = MatrixXs::Zero(n_CV_*(P_-W), n_MV_*size);
+    pool.ParallelFor(n_CV_ * n_MV_, [&](int channel) { // Every channel writes a disjoint block
+        const int i = channel / n_MV_, j = channel % n_MV_;
+        if (!SR_->isNonzero(i, j)) { // Zero block
+            return;
         }
-    }
+        const auto sr = SR_->getChannel(i, j);
+        for (int pad = 0; pad < (P_-W); pad++) {
+            // Row: [S(W+k), ..., S(N-1)] padded with pad S(N)
+            const int row = (i * (P_-W)) + pad, len = std::max(size - pad, 0);
+            tmp_phi.block(row, j * size, 1, len) = sr.segment(W + pad, len).transpose();
+            tmp_phi.block(row, j * size + len, 1, size - len).setConstant(sr(N_-1));
+        }
+    });
     return tmp_phi;
 }
 
-VectorXd FSRModel::PadVec(VectorXd& vec, int pad, double sn) {
-    // Pad vectors with pad number of sn. 
-    VectorXd sn_vec = VectorXd::Constant(pad, sn);
-    VectorXd pad_vec(vec.size() + sn_vec.size());
-    pad_vec << 
-        vec, sn_vec; // Concatinating two Eigen::VectorXd
-    return pad_vec; 
-}
+template <typename Scalar>
+typename FSRModelT<Scalar>::VectorXs FSRModelT<Scalar>::ApplyPhi() const {
+    const int size = N_-W_-1, rows = P_-W_;
+    const VectorXs du_tilde = getDuTilde();
+    VectorXs phi_du = VectorXs::Zero(n_CV_ * rows);
+    VectorXs suffix(size + 1); // suffix(c) = du_tilde(c) + ... + du_tilde(last)
 
-MatrixXd FSRModel::getPsi(int W) {
-    MatrixXd tmp_psi = MatrixXd::Zero(n_CV_*(P_-W), n_MV_);
-    for (int i = 0; i < n_CV_; i++) {
-        for (int j = 0; j < n_MV_; j++) {
-            VectorXd vec = VectorXd::Constant(P_-W, pp_SR_vec_[i][j](Eigen::indexing::last));
-            tmp_psi.block(i*(P_-W), j, P_-W, 1) = vec;
+    for (int j = 0; j < n_MV_; j++) {
+        const auto du = du_tilde.segment(j * size, size);
+        suffix(size) = 0;
+        for (int c = size - 1; c >= 0; c--) {
+            suffix(c) = suffix(c + 1) + du(c);
+        }
+        for (int i = 0; i < n_CV_; i++) {
+            if (!SR_->isNonzero(i, j)) {
+                continue;
+            }
+            typename SRTensorT<Scalar>::ConstChannel sr = SR_->getCanonical(i, j); // Gain applied once per row
+            const Scalar scale = SR_->getScale(i, j);
+            for (int p = 0; p < rows; p++) {
+                // Row p: [S(W+p), ..., S(N-1)] * du_tilde(0 : len) + S(N) * sum(du_tilde(len : last))
+                const int len = std::max(size - p, 0);
+                phi_du(i * rows + p) += scale * (sr.segment(W_ + p, len).dot(du.head(len)) + sr(N_-1) * suffix(len));
+            }
         }
     }
+    return phi_du;
+}
+
+template <typename Scalar>
+typename FSRModelT<Scalar>::MatrixXs FSRModelT<Scalar>::getPsi(int W, ThreadPool& pool) const {
+    MatrixXs tmp_psi = MatrixXs::Zero(n_CV_*(P_-W), n_MV_);
+    pool.ParallelFor(n_CV_, [&](int i) {
+        tmp_psi.block(i*(P_-W), 0, P_-W, n_MV_).rowwise() = SR_->getCoefficients(i, N_-1).transpose(); // S(N)
+    });
     return tmp_psi;
 }
 
-VectorXd FSRModel::getDuTilde() const { // Flattning du_tilde_mat, dependant on W
-    VectorXd du_tilde = VectorXd::Zero(n_MV_*(N_-W_-1));
-    MatrixXd du_tilde_sliced = du_tilde_mat_.block(0, 0, n_CV_, N_-W_-1);
+template <typename Scalar>
+typename FSRModelT<Scalar>::VectorXs FSRModelT<Scalar>::getDuTilde() const { // Flattning du_tilde_mat, dependant on W
+    // Unroll ring buffer: [du(head), ..., du(last), du(0), ..., du(head-1)]
+    const int size = N_-W_-1;
+    VectorXs du_tilde(n_MV_ * size);
     for (int i = 0; i < n_MV_; i++) {
-        du_tilde.block(i * (N_-W_-1), 0, N_-W_-1, 1) = du_tilde_sliced.row(i).transpose();
+        du_tilde.segment(i * size, size - head_) = du_tilde_mat_.row(i).tail(size - head_).transpose();
+        du_tilde.segment(i * size + size - head_, head_) = du_tilde_mat_.row(i).head(head_).transpose();
     }
     return du_tilde;
 }
 
-void FSRModel::UpdateU(const VectorXd& du) { // du = omega_u * z
+template <typename Scalar>
+MatrixXd FSRModelT<Scalar>::getDuTildeMat() const {
+    const int size = N_-W_-1;
+    MatrixXs mat(n_MV_, size);
+    mat.leftCols(size - head_) = du_tilde_mat_.rightCols(size - head_);
+    mat.rightCols(head_) = du_tilde_mat_.leftCols(head_);
+    return mat.template cast<double>();
+}
+
+template <typename Scalar>
+Scalar FSRModelT<Scalar>::getFreeResponseTail(int cv) const {
+    // Row P-W of Phi: [S(P), ..., S(N-1)] padded with S(N), see getPhiMatrix
+    Scalar tail = 0;
+    for (int mv = 0; mv < n_MV_; mv++) {
+        if (!SR_->isNonzero(cv, mv)) {
+            continue;
+        }
+        typename SRTensorT<Scalar>::ConstChannel sr = SR_->getCanonical(cv, mv);
+        Scalar channel = sr(N_-1) * u_(mv);
+        for (int lag = 0; lag < N_-W_-1; lag++) {
+            channel += sr(std::min(P_ + lag, N_-1)) * du_tilde_mat_(mv, RingIndex(lag));
+        }
+        tail += SR_->getScale(cv, mv) * channel;
+    }
+    return tail;
+}
+
+template <typename Scalar>
+void FSRModelT<Scalar>::UpdateU(const VectorXs& du) { // du = omega_u * z
+    // Shift free response one step: Lambda(k+1)[p] = Lambda(k)[p+1] + sum_mv S(W+p) du
+    const int rows = P_-W_;
+    if (ss_) { // x(k+1) = A x(k) + B u(k), the free response is recomputed below
+        x_ = ss_A_ * x_ + ss_B_ * (u_K_ + du);
+    } else if (mat_->kernel) {
+        for (int i = 0; i < n_CV_; i++) {
+            tail_(i) = getFreeResponseTail(i);
+        }
+        mat_->kernel->ShiftLambda(lambda_, du, tail_);
+    } else {
+        for (int i = 0; i < n_CV_; i++) {
+            const int offset = i * rows;
+            const Scalar tail = getFreeResponseTail(i);
+            for (int p = 0; p < rows - 1; p++) {
+                lambda_(offset + p) = lambda_(offset + p + 1);
+            }
+            lambda_(offset + rows - 1) = tail;
+            for (int j = 0; j < n_MV_; j++) {
+                if (SR_->isNonzero(i, j)) {
+                    lambda_.segment(offset, rows) += (du(j) * SR_->getScale(i, j)) * SR_->getCanonical(i, j).segment(W_, rows);
+                }
+            }
+        }
+    }
+
     // Updating U(k-1)
     u_K_ += du; 
-    // Updating U(n)
-    VectorXd du_n = du_tilde_mat_.col(N_-2-W_); // Access last - W elem 
-    u_ += du_n;
-    // Update du_tilde by left shift, adding the optimized du
-    MatrixXd old_du = du_tilde_mat_.leftCols(N_-2-W_);
-    du_tilde_mat_.block(0, 0, n_MV_, 1) = du;
-    du_tilde_mat_.block(0, 1, n_MV_, N_-2-W_) = old_du;
+    // Updating U(n), the oldest actuation leaves du_tilde
+    const int oldest = RingIndex(N_-2-W_);
+    u_ += du_tilde_mat_.col(oldest);
+    // Move head backwards, overwriting the oldest actuation with the optimized du
+    head_ = oldest;
+    du_tilde_mat_.col(head_) = du;
+    if (ss_) {
+        lambda_ = getStateFreeResponse();
+        return;
+    }
+
+    // Debug check, incremental update against full product, relative tolerance sqrt(eps) of the precision
+    assert((lambda_ - getFreeResponse()).norm() <= 
+            std::sqrt(Eigen::NumTraits<Scalar>::epsilon()) * std::max(Scalar(1), lambda_.norm()));
+}
+
+template <typename Scalar>
+typename FSRModelT<Scalar>::Tensor3s FSRModelT<Scalar>::PredictBatch(const MatrixXs& candidate_moves) const {
+    if (candidate_moves.rows() != n_MV_ * getNumMoves()) {
+        throw std::invalid_argument("Candidate moves must have n_MV * n_b rows");
+    }
+    const int rows = P_-W_, K = candidate_moves.cols();
+    MatrixXs Y = mat_->theta * candidate_moves; // One GEMM, (n_CV * (P-W), K)
+    Y.colwise() += getLambda();
+
+    // Column k is [y_1(W+1), ..., y_1(P), ..., y_nCV(P)], viewed as (P-W, n_CV, K) and reordered to (n_CV, P-W, K)
+    Eigen::TensorMap<const Tensor3s> cube(Y.data(), rows, n_CV_, K);
+    return cube.shuffle(Eigen::array<int, 3>{1, 0, 2});
+}
+
+template <typename Scalar>
+std::vector<int> FSRModelT<Scalar>::setMovableRows() const {
+    const int rows = P_-W_;
+    std::vector<int> movable;
+    for (int i = 0; i < n_CV_; i++) {
+        int dead_time = N_;
+        for (int j = 0; j < n_MV_; j++) {
+            dead_time = std::min(dead_time, mat_->theta_op.getDeadTime(i, j));
+        }
+        for (int p = std::max(dead_time - W_, 0); p < rows; p++) {
+            movable.push_back(i * rows + p);
+        }
+    }
+    return movable;
 }
 
-SparseXd FSRModel::getOmegaY() const {
-    MatrixXd omega_dense = MatrixXd::Zero(n_CV_, n_CV_ * P_);
+template <typename Scalar>
+typename FSRModelT<Scalar>::SparseXs FSRModelT<Scalar>::getOmegaY() const {
+    MatrixXs omega_dense = MatrixXs::Zero(n_CV_, n_CV_ * P_);
     for (int i = 0; i < n_CV_; i++) {
         omega_dense(i, i * P_) = 1; 
     }
     return omega_dense.sparseView();
 }  
 
-VectorXd FSRModel::setInitY(std::vector<double> init_y, int predictions) {
-    VectorXd y_init = VectorXd::Zero(n_CV_ * predictions);
+template <typename Scalar>
+typename FSRModelT<Scalar>::VectorXs FSRModelT<Scalar>::setInitY(std::vector<double> init_y, int predictions) {
+    VectorXs y_init = VectorXs::Zero(n_CV_ * predictions);
     for (int cv = 0; cv < n_CV_; cv++) {
-        y_init.block(cv * predictions, 0, predictions, 1) = VectorXd::Constant(predictions, init_y[cv]);
+        y_init.block(cv * predictions, 0, predictions, 1) = VectorXs::Constant(predictions, init_y[cv]);
     }
     return y_init;
 }
 
-void FSRModel::setDuTildeMat(const MatrixXd& mat) { 
-    // Update u_
-    for (int i = 0; i < mat.cols(); i++) {
-        VectorXd vec = mat.col(i);
+template <typename Scalar>
+void FSRModelT<Scalar>::setDuTildeMat(const MatrixXd& mat) { 
+    // Update u_, actuations older than N-1 steps are settled and remain in u_, see CVData::TruncateSR
+    const int cols = std::min(int(mat.cols()), N_-1);
+    for (int i = 0; i < cols; i++) {
+        VectorXs vec = mat.col(i).template cast<Scalar>();
         u_ -= vec;
     }
-    du_tilde_mat_ = mat.block(0, 0, n_CV_, N_-1-W_); 
+    // A shorter history, e.g. saved by a truncated model, is padded with zero actuations
+    const int size = std::min(cols, N_-1-W_);
+    du_tilde_mat_ = MatrixXs::Zero(n_MV_, N_-1-W_);
+    du_tilde_mat_.leftCols(size) = mat.block(0, 0, n_MV_, size).template cast<Scalar>(); 
+    head_ = 0;
+    if (ss_) {
+        ResetState();
+        lambda_ = getStateFreeResponse();
+    } else {
+        lambda_ = getFreeResponse();
+    }
+}
+
+template <typename Scalar>
+void FSRModelT<Scalar>::setStateSpace(std::shared_ptr<const StateSpaceModel> ss) {
+    ss_ = std::move(ss);
+    if (!ss_) {
+        lambda_ = getFreeResponse();
+        return;
+    }
+    if (ss_->B.cols() != n_MV_ || ss_->C.rows() != n_CV_) {
+        throw std::invalid_argument("State space realization does not match the model dimensions");
+    }
+    ss_A_ = ss_->A.template cast<Scalar>();
+    ss_B_ = ss_->B.template cast<Scalar>();
+    ss_C_ = ss_->C.template cast<Scalar>();
+    // The realization settles u_ at its DC gain, the FSR model at S(N)
+    const MatrixXd I = MatrixXd::Identity(ss_->getOrder(), ss_->getOrder());
+    const MatrixXd dc_gain = ss_->C * (I - ss_->A).partialPivLu().solve(ss_->B);
+    ss_D_ = MatrixXs::Zero(n_CV_, n_MV_);
+    for (int cv = 0; cv < n_CV_; cv++) {
+        for (int mv = 0; mv < n_MV_; mv++) {
+            if (SR_->isNonzero(cv, mv)) {
+                ss_D_(cv, mv) = SR_->getScale(cv, mv) * SR_->getCanonical(cv, mv)(N_-1);
+            }
+        }
+    }
+    ss_D_ -= dc_gain.template cast<Scalar>();
+    ResetState();
+    lambda_ = getStateFreeResponse();
+}
+
+template <typename Scalar>
+void FSRModelT<Scalar>::ResetState() {
+    // x(k-L) is settled at u_ = U(k-L-1), then the L actuations of the ring buffer are replayed, oldest first
+    x_ = ss_->SteadyState(u_.template cast<double>()).template cast<Scalar>();
+    VectorXs u = u_;
+    for (int lag = N_-W_-2; lag >= 0; lag--) {
+        u += du_tilde_mat_.col(RingIndex(lag));
+        x_ = ss_A_ * x_ + ss_B_ * u;
+    }
 }
+
+template <typename Scalar>
+typename FSRModelT<Scalar>::VectorXs FSRModelT<Scalar>::getStateFreeResponse() const {
+    const int rows = P_-W_;
+    VectorXs free(n_CV_ * rows), x = x_;
+    const VectorXs Bu = ss_B_ * u_K_; // No future moves, u = U(k-1)
+    const VectorXs settled = ss_D_ * u_;
+    for (int p = 0; p < P_; p++) { // Row p-W of every CV block holds C x(k+p) + (S(N) - C (I - A)^-1 B) u_, like Phi and Psi
+        if (p >= W_) {
+            const VectorXs y = ss_C_ * x + settled;
+            for (int i = 0; i < n_CV_; i++) {
+                free(i * rows + p - W_) = y(i);
+            }
+        }
+        x = ss_A_ * x + Bu;
+    }
+    return free;
+}
+
+template class FSRModelT<double>;
+template class FSRModelT<float>;
@@ -0,0 +1,53 @@
+/**
+ * @file FixedFSRKernel.cc
+ * @author Geir Ola Tvinnereim
+ * @copyright Released under the terms of the BSD 3-Clause License
+ * @date 2023
+ */
+#include "model/FixedFSRKernel.h"
+
+template <typename Scalar>
+using MatrixXs = Eigen::Matrix<Scalar, Eigen::Dynamic, Eigen::Dynamic>;
+
+/**
+ * @brief Instantiate the kernel if the runtime dimensions match the template arguments
+ *
+ * @return std::shared_ptr<const FSRKernel<Scalar>> nullptr on mismatch
+ */
+template <typename Scalar, int nCV, int nMV, int P, int M>
+static std::shared_ptr<const FSRKernel<Scalar>> MatchKernel(const SRTensorT<Scalar>& SR, const MatrixXs<Scalar>& theta, int p, int m) {
+    if (SR.getN_CV() != nCV || SR.getN_MV() != nMV || p != P || m != M || SR.getN() < P) {
+        return nullptr;
+    }
+    return std::make_shared<const FixedFSRKernel<Scalar, nCV, nMV, P, M>>(SR, theta);
+}
+
+/**
+ * @brief Try SISO and 2x2 kernels of horizon P and M
+ */
+template <typename Scalar, int P, int M>
+static std::shared_ptr<const FSRKernel<Scalar>> MatchHorizon(const SRTensorT<Scalar>& SR, const MatrixXs<Scalar>& theta, int p, int m) {
+    if (auto kernel = MatchKernel<Scalar, 1, 1, P, M>(SR, theta, p, m)) {
+        return kernel;
+    }
+    return MatchKernel<Scalar, 2, 2, P, M>(SR, theta, p, m);
+}
+
+template <typename Scalar>
+std::shared_ptr<const FSRKernel<Scalar>> MakeFixedKernel(const SRTensorT<Scalar>& SR, const MatrixXs<Scalar>& theta, int P, int M, int W) {
+    if (W != 0) {
+        return nullptr;
+    }
+    // Registered horizons (P, M), extend the list to add specializations
+    std::shared_ptr<const FSRKernel<Scalar>> kernel;
+    if ((kernel = MatchHorizon<Scalar, 1, 1>(SR, theta, P, M)) ||
+        (kernel = MatchHorizon<Scalar, 10, 5>(SR, theta, P, M)) ||
+        (kernel = MatchHorizon<Scalar, 20, 10>(SR, theta, P, M)) ||
+        (kernel = MatchHorizon<Scalar, 30, 15>(SR, theta, P, M))) {
+        return kernel;
+    }
+    return nullptr;
+}
+
+template std::shared_ptr<const FSRKernel<double>> MakeFixedKernel(const SRTensorT<double>&, const MatrixXs<double>&, int, int, int);
+template std::shared_ptr<const FSRKernel<float>> MakeFixedKernel(const SRTensorT<float>&, const MatrixXs<float>&, int, int, int);
@@ -0,0 +1,172 @@
+/**
+ * @file SRTensor.cc
+ * @author Geir Ola Tvinnereim
+ * @copyright Released under the terms of the BSD 3-Clause License
+ * @date 2023
+ */
+#include "model/SRTensor.h"
+
+#include <cmath>
+#include <algorithm>
+#include <string>
+#include <stdexcept>
+
+template <typename Scalar>
+SRTensorT<Scalar>::SRTensorT(int n_CV, int n_MV, int N) : n_CV_{n_CV}, n_MV_{n_MV}, N_{N}, deduplicated_{false} {
+    // Pad leading dimension such that every channel is aligned
+    const int align = EIGEN_MAX_ALIGN_BYTES / sizeof(Scalar);
+    stride_ = (align > 1) ? ((N + align - 1) / align) * align : N;
+    data_ = VectorXs::Zero(Eigen::Index(n_CV) * n_MV * stride_);
+    canonical_.resize(n_CV * n_MV);
+    for (int c = 0; c < n_CV * n_MV; c++) {
+        canonical_[c] = c;
+    }
+    scale_.assign(n_CV * n_MV, Scalar(1));
+    nonzero_ = ChannelMap::Constant(n_CV, n_MV, true);
+}
+
+template <typename Scalar>
+typename SRTensorT<Scalar>::Channel SRTensorT<Scalar>::getChannel(int cv, int mv) {
+    if (deduplicated_) {
+        throw std::logic_error("Cannot write step responses of a deduplicated tensor");
+    }
+    return Channel(data_.data() + Offset(getCanonicalIndex(cv, mv)), N_);
+}
+
+template <typename Scalar>
+void SRTensorT<Scalar>::UpdateChannelMap() {
+    for (int i = 0; i < n_CV_; i++) {
+        for (int j = 0; j < n_MV_; j++) {
+            nonzero_(i, j) = getScale(i, j) != 0 && !getCanonical(i, j).isZero(0);
+        }
+    }
+}
+
+template <typename Scalar>
+void SRTensorT<Scalar>::Deduplicate(double tol) {
+    std::vector<int> unique; // Channel holding each canonical vector
+    for (int c = 0; c < n_CV_ * n_MV_; c++) {
+        ConstChannel sr(data_.data() + Offset(c), N_);
+        const Scalar norm = sr.norm();
+        canonical_[c] = -1;
+        for (int u = 0; u < int(unique.size()) && canonical_[c] < 0; u++) {
+            ConstChannel ref(data_.data() + Offset(unique[u]), N_);
+            const Scalar ref_norm2 = ref.squaredNorm();
+            if (ref_norm2 == 0) { // Only a zero channel matches a zero reference
+                if (norm == 0) {
+                    canonical_[c] = u;
+                    scale_[c] = 1;
+                }
+                continue;
+            }
+            const Scalar scale = ref.dot(sr) / ref_norm2; // Least squares gain
+            if (norm > 0 && (sr - scale * ref).norm() <= tol * norm) {
+                canonical_[c] = u;
+                scale_[c] = scale;
+            }
+        }
+        if (canonical_[c] < 0) {
+            canonical_[c] = int(unique.size());
+            scale_[c] = 1;
+            unique.push_back(c);
+        }
+    }
+
+    // Compact the canonical vectors to the front of the buffer, unique[u] >= u
+    for (int u = 0; u < int(unique.size()); u++) {
+        data_.segment(Offset(u), stride_) = data_.segment(Offset(unique[u]), stride_);
+    }
+    data_.conservativeResize(Eigen::Index(unique.size()) * stride_);
+    deduplicated_ = true;
+}
+
+template <typename Scalar>
+typename SRTensorT<Scalar>::VectorXs SRTensorT<Scalar>::getCoefficients(int cv, int k) const {
+    VectorXs coefficients(n_MV_);
+    for (int mv = 0; mv < n_MV_; mv++) {
+        coefficients(mv) = (*this)(cv, mv, k);
+    }
+    return coefficients;
+}
+
+template <typename Scalar>
+int SRTensorT<Scalar>::getDeadTime(int cv, int mv, double tol) const {
+    ConstChannel sr = getCanonical(cv, mv); // Relative tolerance, independent of the channel gain
+    const double bound = tol * sr.cwiseAbs().maxCoeff();
+    int k = 0;
+    while (k < N_ && std::abs(sr(k)) <= bound) {
+        k++;
+    }
+    return k;
+}
+
+template <typename Scalar>
+int SRTensorT<Scalar>::getSettlingIndex(int cv, int mv, double tol) const {
+    ConstChannel sr = getCanonical(cv, mv);
+    const double bound = tol * sr.cwiseAbs().maxCoeff();
+    int k = N_-1;
+    while (k > 0 && std::abs(sr(k-1) - sr(N_-1)) <= bound) {
+        k--;
+    }
+    return k;
+}
+
+template <typename Scalar>
+std::shared_ptr<const SRTensorT<Scalar>> SRTensorT<Scalar>::Truncate(int N) const {
+    if (N < 1 || N > N_) {
+        throw std::out_of_range("Cannot truncate step responses to N = " + std::to_string(N));
+    }
+    auto SR = std::make_shared<SRTensorT>(n_CV_, n_MV_, N);
+    const int n_canonical = getNumCanonical();
+    SR->data_.setZero(Eigen::Index(n_canonical) * SR->stride_);
+    for (int u = 0; u < n_canonical; u++) {
+        SR->data_.segment(SR->Offset(u), N) = data_.segment(Offset(u), N);
+    }
+    SR->canonical_ = canonical_;
+    SR->scale_ = scale_;
+    SR->nonzero_ = nonzero_;
+    SR->deduplicated_ = deduplicated_;
+    return SR;
+}
+
+template <typename Scalar>
+std::shared_ptr<const SRTensorT<Scalar>> SRTensorT<Scalar>::Resample(int factor) const {
+    if (factor < 1) {
+        throw std::out_of_range("Cannot resample step responses by a factor " + std::to_string(factor));
+    }
+    const int N = (N_ + factor - 1) / factor;
+    auto SR = std::make_shared<SRTensorT>(n_CV_, n_MV_, N);
+    const int n_canonical = getNumCanonical();
+    SR->data_.setZero(Eigen::Index(n_canonical) * SR->stride_);
+    for (int u = 0; u < n_canonical; u++) {
+        for (int k = 0; k < N; k++) {
+            // Coarse step k+1 ends at fine step (k+1) * factor, the last one is clamped to S(N)
+            SR->data_(SR->Offset(u) + k) = data_(Offset(u) + std::min((k + 1) * factor, N_) - 1);
+        }
+    }
+    SR->canonical_ = canonical_;
+    SR->scale_ = scale_;
+    SR->nonzero_ = nonzero_;
+    SR->deduplicated_ = deduplicated_;
+    return SR;
+}
+
+template <typename Scalar>
+template <typename Other>
+std::shared_ptr<const SRTensorT<Other>> SRTensorT<Scalar>::Cast() const {
+    auto SR = std::make_shared<SRTensorT<Other>>(n_CV_, n_MV_, N_);
+    const int n_canonical = getNumCanonical();
+    SR->data_.setZero(Eigen::Index(n_canonical) * SR->stride_);
+    for (int u = 0; u < n_canonical; u++) {
+        SR->data_.segment(SR->Offset(u), N_) = data_.segment(Offset(u), N_).template cast<Other>();
+    }
+    SR->canonical_ = canonical_;
+    SR->scale_.assign(scale_.begin(), scale_.end());
+    SR->nonzero_ = nonzero_;
+    SR->deduplicated_ = deduplicated_;
+    return SR;
+}
+
+template class SRTensorT<double>;
+template class SRTensorT<float>;
+template std::shared_ptr<const SRTensorT<float>> SRTensorT<double>::Cast<float>() const;
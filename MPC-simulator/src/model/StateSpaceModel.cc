@@ -0,0 +1,98 @@
+/**
+ * @file StateSpaceModel.cc
+ * @author Geir Ola Tvinnereim
+ * @copyright  Released under the terms of the BSD 3-Clause License
+ * @date 2023
+ */
+#include "model/StateSpaceModel.h"
+
+#include <sstream>
+#include <vector>
+#include <cmath>
+#include <algorithm>
+#include <stdexcept>
+
+VectorXd StateSpaceModel::SteadyState(const VectorXd& u) const {
+    const MatrixXd I = MatrixXd::Identity(getOrder(), getOrder());
+    return (I - A).partialPivLu().solve(B * u);
+}
+
+std::string StateSpaceModel::Report() const {
+    Eigen::Index cv, mv;
+    const double worst = step_error.maxCoeff(&cv, &mv);
+    std::ostringstream report;
+    report << "ERA realization of order " << getOrder() << ", max relative step response error " << worst
+           << " (CV " << cv + 1 << ", MV " << mv + 1 << "), Hankel singular values " << hankel_sv(0) << " ... "
+           << hankel_sv(getOrder() - 1);
+    if (hankel_sv.size() > getOrder()) {
+        report << " | " << hankel_sv(getOrder());
+    }
+    return report.str();
+}
+
+/**
+ * @brief Helper function. Markov parameter k of the step responses, S(k) - S(k-1), S(0) = 0
+ *
+ * @param SR step response tensor
+ * @param k 1 <= k <= N
+ * @return MatrixXd (n_CV, n_MV)
+ */
+static MatrixXd Markov(const SRTensor& SR, int k) {
+    MatrixXd h(SR.getN_CV(), SR.getN_MV());
+    for (int i = 0; i < SR.getN_CV(); i++) {
+        for (int j = 0; j < SR.getN_MV(); j++) {
+            h(i, j) = SR(i, j, k-1) - (k > 1 ? SR(i, j, k-2) : 0.0);
+        }
+    }
+    return h;
+}
+
+std::shared_ptr<const StateSpaceModel> RealizeERA(const SRTensor& SR, int order) {
+    const int n_CV = SR.getN_CV(), n_MV = SR.getN_MV(), N = SR.getN();
+    // H0(r, c) = h(r+c+1), H1(r, c) = h(r+c+2), every Markov parameter up to h(N) is used
+    const int rows = N / 2, cols = N - rows - 1;
+    if (cols < 1) {
+        throw std::invalid_argument("Too few step response coefficients for a realization");
+    }
+    std::vector<MatrixXd> h(N + 1);
+    for (int k = 1; k <= N; k++) {
+        h[k] = Markov(SR, k);
+    }
+    MatrixXd H0(rows * n_CV, cols * n_MV), H1(rows * n_CV, cols * n_MV);
+    for (int r = 0; r < rows; r++) {
+        for (int c = 0; c < cols; c++) {
+            H0.block(r * n_CV, c * n_MV, n_CV, n_MV) = h[r + c + 1];
+            H1.block(r * n_CV, c * n_MV, n_CV, n_MV) = h[r + c + 2];
+        }
+    }
+
+    Eigen::BDCSVD<MatrixXd> svd(H0, Eigen::ComputeThinU | Eigen::ComputeThinV);
+    const VectorXd& sv = svd.singularValues();
+    if (order < 1 || order > sv.size() || sv(order - 1) <= 1e-12 * sv(0)) {
+        throw std::invalid_argument("Realization order must be in [1, rank(H0)], rank(H0) <= " + std::to_string(sv.size()));
+    }
+    const VectorXd sqrt_sv = sv.head(order).cwiseSqrt(), inv_sqrt_sv = sqrt_sv.cwiseInverse();
+    const MatrixXd U = svd.matrixU().leftCols(order), V = svd.matrixV().leftCols(order);
+
+    auto ss = std::make_shared<StateSpaceModel>();
+    ss->A = inv_sqrt_sv.asDiagonal() * (U.transpose() * H1 * V) * inv_sqrt_sv.asDiagonal();
+    ss->B = (sqrt_sv.asDiagonal() * V.transpose()).leftCols(n_MV);
+    ss->C = (U * sqrt_sv.asDiagonal()).topRows(n_CV);
+    ss->hankel_sv = sv;
+
+    // Error report: step response of the realization, sum of C A^(i-1) B, against S
+    ss->step_error = MatrixXd::Zero(n_CV, n_MV);
+    MatrixXd peak = MatrixXd::Zero(n_CV, n_MV), step = MatrixXd::Zero(n_CV, n_MV), AkB = ss->B;
+    for (int k = 1; k <= N; k++) {
+        step += ss->C * AkB;
+        AkB = ss->A * AkB;
+        for (int i = 0; i < n_CV; i++) {
+            for (int j = 0; j < n_MV; j++) {
+                ss->step_error(i, j) = std::max(ss->step_error(i, j), std::abs(step(i, j) - SR(i, j, k-1)));
+                peak(i, j) = std::max(peak(i, j), std::abs(SR(i, j, k-1)));
+            }
+        }
+    }
+    ss->step_error = (peak.array() > 0).select(ss->step_error.array() / peak.array(), ss->step_error.array()).matrix();
+    return ss;
+}
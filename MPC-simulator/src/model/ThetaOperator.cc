@@ -0,0 +1,129 @@
+/**
+ * @file ThetaOperator.cc
+ * @author Geir Ola Tvinnereim
+ * @copyright Released under the terms of the BSD 3-Clause License
+ * @date 2023
+ */
+#include "model/ThetaOperator.h"
+
+#include <cmath>
+#include <algorithm>
+
+template <typename Scalar>
+ThetaOperatorT<Scalar>::ThetaOperatorT(TensorPtr SR, int P, int M, int W, ThetaKernel kernel, ThreadPool* pool) :
+                    P_{P}, M_{M}, W_{W}, kernel_{kernel}, SR_{std::move(SR)} {
+    n_CV_ = SR_->getN_CV();
+    n_MV_ = SR_->getN_MV();
+    dead_time_.resize(n_CV_ * n_MV_);
+    for (int i = 0; i < n_CV_; i++) {
+        for (int j = 0; j < n_MV_; j++) {
+            dead_time_[i * n_MV_ + j] = SR_->getDeadTime(i, j, kDeadTimeTol);
+        }
+    }
+
+    // Linear convolution of P coefficients and M actuations without wrap-around
+    nfft_ = 1;
+    while (nfft_ < P_ + M_ - 1) {
+        nfft_ *= 2;
+    }
+
+    if (kernel_ == ThetaKernel::AUTO) {
+        kernel_ = ChooseKernel();
+    }
+    if (kernel_ == ThetaKernel::FFT) {
+        ThreadPool serial;
+        setSpectra(pool ? *pool : serial);
+    }
+}
+
+template <typename Scalar>
+ThetaKernel ThetaOperatorT<Scalar>::ChooseKernel() const {
+    const double channels = SR_->getChannelMap().count(); // Zero channels are skipped by both kernels
+    // Direct: two flops per nonzero of the lower triangular blocks
+    const double direct = 2.0 * channels * (double(P_ - W_) * M_ - 0.5 * std::max(M_ - W_, 0) * std::max(M_ - W_, 0));
+    // FFT: n_MV forward and n_CV inverse transforms, and a complex multiply-add per channel and frequency
+    const double transforms = (n_CV_ + n_MV_) * 5.0 * nfft_ * std::log2(double(nfft_));
+    const double products = 8.0 * channels * (nfft_ / 2 + 1);
+    return (transforms + products < direct) ? ThetaKernel::FFT : ThetaKernel::DIRECT;
+}
+
+template <typename Scalar>
+Eigen::FFT<Scalar>& ThetaOperatorT<Scalar>::getEngine() {
+    thread_local Eigen::FFT<Scalar> fft;
+    fft.SetFlag(Eigen::FFT<Scalar>::HalfSpectrum);
+    return fft;
+}
+
+template <typename Scalar>
+void ThetaOperatorT<Scalar>::setSpectra(ThreadPool& pool) {
+    // One spectrum per canonical vector, channels sharing a vector differ by their gain only
+    std::vector<int> owner(SR_->getNumCanonical(), -1);
+    for (int channel = n_CV_ * n_MV_ - 1; channel >= 0; channel--) {
+        if (SR_->isNonzero(channel / n_MV_, channel % n_MV_)) {
+            owner[SR_->getCanonicalIndex(channel / n_MV_, channel % n_MV_)] = channel;
+        }
+    }
+    spectra_.resize(owner.size());
+    pool.ParallelFor(int(owner.size()), [&](int canonical) {
+        if (owner[canonical] < 0) { // Only used by zero channels, no spectrum
+            return;
+        }
+        VectorXs padded = VectorXs::Zero(nfft_);
+        padded.head(P_) = SR_->getCanonical(owner[canonical] / n_MV_, owner[canonical] % n_MV_).head(P_);
+        getEngine().fwd(spectra_[canonical], padded);
+    });
+}
+
+template <typename Scalar>
+typename ThetaOperatorT<Scalar>::VectorXs ThetaOperatorT<Scalar>::Apply(const VectorXs& du) const {
+    return (kernel_ == ThetaKernel::FFT) ? ApplyFFT(du) : ApplyDirect(du);
+}
+
+template <typename Scalar>
+typename ThetaOperatorT<Scalar>::VectorXs ThetaOperatorT<Scalar>::ApplyDirect(const VectorXs& du) const {
+    // y(r) = sum_c S(W+r-c) du(c), accumulated column by column for r >= max(d+c-W, 0), d being the dead time
+    const int rows = P_ - W_;
+    VectorXs y = VectorXs::Zero(n_CV_ * rows);
+    for (int i = 0; i < n_CV_; i++) {
+        for (int j = 0; j < n_MV_; j++) {
+            typename SRTensorT<Scalar>::ConstChannel sr = SR_->getCanonical(i, j);
+            const Scalar scale = SR_->getScale(i, j);
+            const int d = getDeadTime(i, j);
+            for (int c = 0; c < M_ && d + c - W_ < rows; c++) {
+                const int start = std::max(d + c - W_, 0);
+                y.segment(i * rows + start, rows - start) += (scale * du(j * M_ + c)) * sr.segment(W_ + start - c, rows - start);
+            }
+        }
+    }
+    return y;
+}
+
+template <typename Scalar>
+typename ThetaOperatorT<Scalar>::VectorXs ThetaOperatorT<Scalar>::ApplyFFT(const VectorXs& du) const {
+    // y = IFFT(sum_mv FFT(S) .* FFT(du)), sliced from W
+    const int rows = P_ - W_;
+    Eigen::FFT<Scalar>& fft = getEngine();
+    std::vector<VectorXcs> du_hat(n_MV_);
+    VectorXs padded = VectorXs::Zero(nfft_);
+    for (int j = 0; j < n_MV_; j++) {
+        padded.head(M_) = du.segment(j * M_, M_);
+        fft.fwd(du_hat[j], padded);
+    }
+
+    VectorXs y(n_CV_ * rows), conv(nfft_);
+    VectorXcs y_hat(nfft_ / 2 + 1);
+    for (int i = 0; i < n_CV_; i++) {
+        y_hat.setZero();
+        for (int j = 0; j < n_MV_; j++) {
+            if (SR_->isNonzero(i, j)) {
+                y_hat += SR_->getScale(i, j) * spectra_[SR_->getCanonicalIndex(i, j)].cwiseProduct(du_hat[j]);
+            }
+        }
+        fft.inv(conv, y_hat, nfft_);
+        y.segment(i * rows, rows) = conv.segment(W_, rows);
+    }
+    return y;
+}
+
+template class ThetaOperatorT<double>;
+template class ThetaOperatorT<float>;
@@ -0,0 +1,74 @@
+/**
+ * @file ThreadPool.cc
+ * @author Geir Ola Tvinnereim
+ * @copyright Released under the terms of the BSD 3-Clause License
+ * @date 2023
+ */
+#include "model/ThreadPool.h"
+
+ThreadPool::ThreadPool(int n_threads) : body_{nullptr}, count_{0}, next_{0}, active_{0}, generation_{0}, stop_{false} {
+    for (int i = 1; i < n_threads; i++) {
+        workers_.emplace_back(&ThreadPool::WorkerLoop, this);
+    }
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stop_ = true;
+    }
+    start_cv_.notify_all();
+    for (auto& worker : workers_) {
+        worker.join();
+    }
+}
+
+void ThreadPool::RunIterations() {
+    for (int i = next_++; i < count_; i = next_++) {
+        (*body_)(i);
+    }
+}
+
+void ThreadPool::WorkerLoop() {
+    unsigned long seen = 0;
+    while (true) {
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            start_cv_.wait(lock, [&] { return stop_ || generation_ != seen; });
+            if (stop_) {
+                return;
+            }
+            seen = generation_;
+        }
+        RunIterations();
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (--active_ == 0) {
+                done_cv_.notify_one();
+            }
+        }
+    }
+}
+
+void ThreadPool::ParallelFor(int count, const std::function<void(int)>& body) {
+    if (workers_.empty() || count <= 1) {
+        for (int i = 0; i < count; i++) {
+            body(i);
+        }
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        body_ = &body;
+        count_ = count;
+        next_ = 0;
+        active_ = int(workers_.size());
+        generation_++;
+    }
+    start_cv_.notify_all();
+    RunIterations();
+
+    // Wait for the workers to leave the loop before body goes out of scope
+    std::unique_lock<std::mutex> lock(mutex_);
+    done_cv_.wait(lock, [&] { return active_ == 0; });
+}
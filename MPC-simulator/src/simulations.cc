@@ -50,51 +50,38 @@ static MatrixXd setRef(const string& ref_str, int T, int P, int n_CV) {
     return ref;
 }
 
-void MPCSimFSRM(const string& sys, const string& ref_vec, bool new_sim, int T) {
-    // Mapping to Data folder
-    const string sim = "sim_" + sys;
-    const string sce_path = "../data/scenarios/sce_" + sys + ".json";
-    const string sim_path = "../data/simulations/" + sim + ".json";
-
-    // System variables:
-    CVData cvd; 
-    MVData mvd;
-    std::map<string, int> m_map;
-
-    // Scenario variables:
-    VectorXd z_min, z_max; /** Constraint vectors */
-    MPCConfig conf; 
-    MatrixXd du_tilde; 
-
-    try { // Parse information:
-        if (new_sim) {
-            ParseNew(sce_path, m_map, cvd, mvd, conf, z_min, z_max);
-        } else {
-            // In order to change offset in u and y, this cvd, mvd and du_tilde need to be update here.
-            Parse(sce_path, sim_path, m_map, cvd, mvd, conf, z_min, z_max, du_tilde); 
-        }
-    }
-    catch(std::exception& e) {
-        std::cout << e.what() << std::endl;
-        exit(1);
-    }
-
-    // Determine simulation type:
-    MPC_FSRM_Simulation sim_type;
-    bool reduced_cost = (conf.W != 0); // Simulate smaller QP
-    if (reduced_cost && conf.disable_slack) {
-        sim_type = MPC_FSRM_Simulation::CONDENSED_W_WoSlack;
-    } else if (conf.disable_slack) {
-        sim_type = MPC_FSRM_Simulation::CONDENSED_WoSlack;
-    } else if (reduced_cost) {
-        sim_type = MPC_FSRM_Simulation::CONDENSED_W;
-    } else {
-        sim_type = MPC_FSRM_Simulation::CONDENSED;
+/**
+ * @brief Simulate the MPC with an FSRModel of precision Scalar, and serialize the simulation
+ * 
+ * @tparam Scalar precision of the FSRModel, see MPCConfig::single_precision
+ * @param sim_type simulation type
+ * @param sys system name
+ * @param ref_vec reference string
+ * @param new_sim new simulation
+ * @param T MPC horizon
+ * @param sim_path path to simulation file
+ * @param cvd CVData
+ * @param mvd MVData
+ * @param m_map model parameters
+ * @param conf MPC configuration
+ * @param z_min lower constraint vector
+ * @param z_max upper constraint vector
+ * @param du_tilde past actuations of a previous simulation
+ */
+template <typename Scalar>
+static void SimulateFSRM(MPC_FSRM_Simulation sim_type, const string& sys, const string& ref_vec, bool new_sim, int T, 
+                    const string& sim_path, const CVData& cvd, const MVData& mvd, std::map<string, int>& m_map, 
+                    const MPCConfig& conf, const VectorXd& z_min, const VectorXd& z_max, const MatrixXd& du_tilde) {
+    const auto SR = ToPrecision<Scalar>(cvd.getSR()); // Shared by every model of the simulation
+    // Optional state space realization computing the free response, realized once in double from the parsed step responses
+    const auto ss = conf.ss_order > 0 ? RealizeERA(*cvd.getSR(), conf.ss_order) : nullptr;
+    if (ss) {
+        std::cout << ss->Report() << std::endl;
     }
-
     switch (sim_type) {
         case MPC_FSRM_Simulation::CONDENSED: {
-            FSRModel fsr(cvd.getSR(), m_map, conf, mvd.Inits, cvd.getInits());
+            FSRModelT<Scalar> fsr(SR, m_map, conf, mvd.Inits, cvd.getInits());
+            fsr.setStateSpace(ss);
             if (!new_sim) {
                 fsr.setDuTildeMat(du_tilde); 
             }
@@ -121,8 +108,10 @@ void MPCSimFSRM(const string& sys, const string& ref_vec, bool new_sim, int T) {
         case MPC_FSRM_Simulation::CONDENSED_W: {
             MPCConfig sim_conf = conf;
             sim_conf.W = 0;
-            FSRModel fsr_sim(cvd.getSR(), m_map, sim_conf, mvd.Inits, cvd.getInits());
-            FSRModel fsr_cost(cvd.getSR(), m_map, conf, mvd.Inits, cvd.getInits());
+            FSRModelT<Scalar> fsr_sim(SR, m_map, sim_conf, mvd.Inits, cvd.getInits());
+            fsr_sim.setStateSpace(ss);
+            FSRModelT<Scalar> fsr_cost(SR, m_map, conf, mvd.Inits, cvd.getInits());
+            fsr_cost.setStateSpace(ss);
 
             if (!new_sim) {
                 fsr_sim.setDuTildeMat(du_tilde); 
@@ -150,7 +139,8 @@ void MPCSimFSRM(const string& sys, const string& ref_vec, bool new_sim, int T) {
         }
 
         case MPC_FSRM_Simulation::CONDENSED_WoSlack: {
-            FSRModel fsr(cvd.getSR(), m_map, conf, mvd.Inits, cvd.getInits());
+            FSRModelT<Scalar> fsr(SR, m_map, conf, mvd.Inits, cvd.getInits());
+            fsr.setStateSpace(ss);
             if (!new_sim) {
                 fsr.setDuTildeMat(du_tilde); 
             }
@@ -178,8 +168,10 @@ void MPCSimFSRM(const string& sys, const string& ref_vec, bool new_sim, int T) {
         case MPC_FSRM_Simulation::CONDENSED_W_WoSlack: {
             MPCConfig sim_conf = conf;
             sim_conf.W = 0;
-            FSRModel fsr_sim(cvd.getSR(), m_map, sim_conf, mvd.Inits, cvd.getInits());
-            FSRModel fsr_cost(cvd.getSR(), m_map, conf, mvd.Inits, cvd.getInits());
+            FSRModelT<Scalar> fsr_sim(SR, m_map, sim_conf, mvd.Inits, cvd.getInits());
+            fsr_sim.setStateSpace(ss);
+            FSRModelT<Scalar> fsr_cost(SR, m_map, conf, mvd.Inits, cvd.getInits());
+            fsr_cost.setStateSpace(ss);
 
             if (!new_sim) {
                 fsr_sim.setDuTildeMat(du_tilde); 
@@ -206,4 +198,53 @@ void MPCSimFSRM(const string& sys, const string& ref_vec, bool new_sim, int T) {
             break;
         }
     }
+}
+
+void MPCSimFSRM(const string& sys, const string& ref_vec, bool new_sim, int T) {
+    // Mapping to Data folder
+    const string sim = "sim_" + sys;
+    const string sce_path = "../data/scenarios/sce_" + sys + ".json";
+    const string sim_path = "../data/simulations/" + sim + ".json";
+
+    // System variables:
+    CVData cvd; 
+    MVData mvd;
+    std::map<string, int> m_map;
+
+    // Scenario variables:
+    VectorXd z_min, z_max; /** Constraint vectors */
+    MPCConfig conf; 
+    MatrixXd du_tilde; 
+
+    try { // Parse information:
+        if (new_sim) {
+            ParseNew(sce_path, m_map, cvd, mvd, conf, z_min, z_max);
+        } else {
+            // In order to change offset in u and y, this cvd, mvd and du_tilde need to be update here.
+            Parse(sce_path, sim_path, m_map, cvd, mvd, conf, z_min, z_max, du_tilde); 
+        }
+    }
+    catch(std::exception& e) {
+        std::cout << e.what() << std::endl;
+        exit(1);
+    }
+
+    // Determine simulation type:
+    MPC_FSRM_Simulation sim_type;
+    bool reduced_cost = (conf.W != 0); // Simulate smaller QP
+    if (reduced_cost && conf.disable_slack) {
+        sim_type = MPC_FSRM_Simulation::CONDENSED_W_WoSlack;
+    } else if (conf.disable_slack) {
+        sim_type = MPC_FSRM_Simulation::CONDENSED_WoSlack;
+    } else if (reduced_cost) {
+        sim_type = MPC_FSRM_Simulation::CONDENSED_W;
+    } else {
+        sim_type = MPC_FSRM_Simulation::CONDENSED;
+    }
+
+    if (conf.single_precision) {
+        SimulateFSRM<float>(sim_type, sys, ref_vec, new_sim, T, sim_path, cvd, mvd, m_map, conf, z_min, z_max, du_tilde);
+    } else {
+        SimulateFSRM<double>(sim_type, sys, ref_vec, new_sim, T, sim_path, cvd, mvd, m_map, conf, z_min, z_max, du_tilde);
+    }
 }
\ No newline at end of file
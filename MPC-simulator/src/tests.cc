@@ -15,15 +15,21 @@
 #include "IO/parse.h"
 
 #include "wasm/wasm.h"
+#include "model/FSRModel.h"
+#include "MPC/solvers.h"
 
 #include <iostream>
 #include <vector>
 #include <map>
+#include <chrono>
+#include <cmath>
+#include <algorithm>
 
 #include <Eigen/Dense>
 #include <nlohmann/json.hpp>
 
 using VectorXd = Eigen::VectorXd;
+using MatrixXd = Eigen::MatrixXd;
 using json = nlohmann::json; 
 using string = std::string;
 
@@ -81,4 +87,187 @@ void TestSimulate(const string& sys, const string& ref_vec, int T) {
     string data = simulate(sce_file, sys_file, sce_name, ref_vec, T);
     
     std::cout << data << std::endl;
-}
\ No newline at end of file
+}
+
+void BenchmarkModelConstruction(int n_CV, int n_MV, int N, int P, int M, int max_threads) {
+    // Synthetic first order responses with dead time, S(k) = K (1 - exp(-(k - d) / tau))
+    auto SR = std::make_shared<SRTensor>(n_CV, n_MV, N);
+    for (int i = 0; i < n_CV; i++) {
+        for (int j = 0; j < n_MV; j++) {
+            const double gain = 1.0 + (i + 2 * j) % 7, tau = 5.0 + (3 * i + j) % 40;
+            const int dead_time = (i + j) % 5;
+            for (int k = dead_time; k < N; k++) {
+                SR->getChannel(i, j)(k) = gain * (1 - std::exp(-(k - dead_time + 1) / tau));
+            }
+        }
+    }
+    SR->UpdateChannelMap();
+    std::map<string, int> m_map = {{kN_CV, n_CV}, {kN_MV, n_MV}, {kN, N}};
+    MPCConfig conf;
+    conf.P = P;
+    conf.M = M;
+    conf.W = 0;
+    const std::vector<double> init_u(n_MV, 0.0), init_y(n_CV, 0.0);
+
+    double serial_time = 0;
+    MatrixXd serial_theta;
+    for (int threads = 1; threads <= max_threads; threads *= 2) {
+        conf.threads = threads;
+        auto start = std::chrono::steady_clock::now();
+        FSRModel fsr(SR, m_map, conf, init_u, init_y);
+        auto end = std::chrono::steady_clock::now();
+        const double time = std::chrono::duration<double, std::milli>(end - start).count();
+
+        if (threads == 1) {
+            serial_time = time;
+            serial_theta = fsr.getTheta();
+        }
+        const bool identical = (fsr.getTheta() == serial_theta);
+        std::cout << "threads: " << threads << ", construction: " << time << " ms, speedup: " << serial_time / time 
+                  << (identical ? "" : ", Theta differs from serial result!") << std::endl;
+    }
+}
+
+/**
+ * @brief Run the closed loop of a parsed scenario with an FSRModel of precision Scalar
+ * 
+ * @return double wall time in ms
+ */
+template <typename Scalar>
+static double RunClosedLoop(int T, MatrixXd& u_mat, MatrixXd& y_pred, const CVData& cvd, const MVData& mvd, std::map<string, int>& m_map, 
+                            const MPCConfig& conf, const VectorXd& z_min, const VectorXd& z_max, const MatrixXd& ref) {
+    auto start = std::chrono::steady_clock::now();
+    const auto SR = ToPrecision<Scalar>(cvd.getSR());
+    if (conf.W == 0) {
+        FSRModelT<Scalar> fsr(SR, m_map, conf, mvd.Inits, cvd.getInits());
+        conf.disable_slack ? SRSolverWoSlack(T, u_mat, y_pred, fsr, conf, z_min, z_max, ref) 
+                           : SRSolver(T, u_mat, y_pred, fsr, conf, z_min, z_max, ref);
+    } else {
+        MPCConfig sim_conf = conf;
+        sim_conf.W = 0;
+        FSRModelT<Scalar> fsr_sim(SR, m_map, sim_conf, mvd.Inits, cvd.getInits());
+        FSRModelT<Scalar> fsr_cost(SR, m_map, conf, mvd.Inits, cvd.getInits());
+        conf.disable_slack ? SRSolverWoSlack(T, u_mat, y_pred, fsr_sim, fsr_cost, conf, z_min, z_max, ref) 
+                           : SRSolver(T, u_mat, y_pred, fsr_sim, fsr_cost, conf, z_min, z_max, ref);
+    }
+    auto end = std::chrono::steady_clock::now();
+    return std::chrono::duration<double, std::milli>(end - start).count();
+}
+
+void ValidatePrecision(const string& sys, const string& ref_str, int T) {
+    const string sce_path = "../data/scenarios/sce_" + sys + ".json";
+    CVData cvd; 
+    MVData mvd;
+    std::map<string, int> m_map;
+    MPCConfig conf;
+    VectorXd z_min, z_max;
+    ParseNew(sce_path, m_map, cvd, mvd, conf, z_min, z_max);
+
+    std::vector<double> ref_vec = ParseRefString(ref_str);
+    MatrixXd ref(ref_vec.size(), T + conf.P + 1);
+    for (int i = 0; i < int(ref_vec.size()); i++) {
+        ref.row(i).setConstant(ref_vec[i]);
+    }
+
+    MatrixXd u64, y64, u32, y32;
+    const double time64 = RunClosedLoop<double>(T, u64, y64, cvd, mvd, m_map, conf, z_min, z_max, ref);
+    const double time32 = RunClosedLoop<float>(T, u32, y32, cvd, mvd, m_map, conf, z_min, z_max, ref);
+
+    // Deviation of the closed loop trajectories, relative to the largest magnitude of the float64 trajectory
+    const double du = (u32 - u64).cwiseAbs().maxCoeff(), dy = (y32 - y64).cwiseAbs().maxCoeff();
+    const double u_scale = std::max(1.0, u64.cwiseAbs().maxCoeff()), y_scale = std::max(1.0, y64.cwiseAbs().maxCoeff());
+    std::cout << "float64: " << time64 << " ms, float32: " << time32 << " ms" << std::endl;
+    std::cout << "u max deviation: " << du << " (relative " << du / u_scale << ")" << std::endl;
+    std::cout << "y max deviation: " << dy << " (relative " << dy / y_scale << ")" << std::endl;
+}
+
+void BenchmarkFork(const string& sys, int n_forks, int threads) {
+    const string sce_path = "../data/scenarios/sce_" + sys + ".json";
+    CVData cvd; 
+    MVData mvd;
+    std::map<string, int> m_map;
+    MPCConfig conf;
+    VectorXd z_min, z_max;
+    ParseNew(sce_path, m_map, cvd, mvd, conf, z_min, z_max);
+
+    auto start = std::chrono::steady_clock::now();
+    FSRModel fsr(cvd.getSR(), m_map, conf, mvd.Inits, cvd.getInits());
+    auto end = std::chrono::steady_clock::now();
+    const double construction = std::chrono::duration<double, std::milli>(end - start).count();
+    const VectorXd lambda = fsr.getLambda();
+
+    std::vector<FSRModel> forks;
+    forks.reserve(n_forks);
+    start = std::chrono::steady_clock::now();
+    for (int f = 0; f < n_forks; f++) {
+        forks.push_back(fsr.fork());
+    }
+    end = std::chrono::steady_clock::now();
+    const double fork = std::chrono::duration<double, std::micro>(end - start).count() / std::max(n_forks, 1);
+    bool identical = true; // A fork starts at the free response of the origin
+    for (const FSRModel& forked : forks) {
+        identical = identical && (forked.getLambda() == lambda);
+    }
+
+    // Every fork takes one unit step of every MV and predicts a unit move sequence, the reference is computed serially
+    const VectorXd du = VectorXd::Ones(fsr.getN_MV()), moves = VectorXd::Ones(fsr.getN_MV() * fsr.getNumMoves());
+    FSRModel reference = fsr.fork();
+    reference.UpdateU(du);
+    const VectorXd y = reference.ApplyTheta(moves) + reference.getLambda();
+
+    // The forks are stepped concurrently and share the Theta operator, every prediction must equal the reference
+    std::vector<char> agrees(n_forks);
+    ThreadPool pool(threads);
+    start = std::chrono::steady_clock::now();
+    pool.ParallelFor(n_forks, [&](int f) {
+        forks[f].UpdateU(du);
+        agrees[f] = (forks[f].ApplyTheta(moves) + forks[f].getLambda() == y);
+    });
+    end = std::chrono::steady_clock::now();
+    const double step = std::chrono::duration<double, std::micro>(end - start).count() / std::max(n_forks, 1);
+    const bool concurrent = std::all_of(agrees.begin(), agrees.end(), [](char agree) { return agree; });
+    const bool unaffected = (fsr.getLambda() == lambda);
+
+    const string kernel = fsr.isFixedSize() ? "fixed-size" : (fsr.getThetaKernel() == ThetaKernel::FFT ? "FFT" : "direct");
+    std::cout << "construction: " << construction << " ms, fork: " << fork << " us, step and predict: " << step 
+              << " us per fork on " << pool.getNumThreads() << " threads, " << kernel << " Theta kernel"
+              << (identical ? "" : ", a fork differs from the origin!")
+              << (concurrent ? "" : ", concurrent forks differ from the serial prediction!")
+              << (unaffected ? "" : ", stepping a fork changed the origin!") << std::endl;
+}
+
+void ValidateStateSpace(const string& sys, int order, int steps) {
+    const string sce_path = "../data/scenarios/sce_" + sys + ".json";
+    CVData cvd; 
+    MVData mvd;
+    std::map<string, int> m_map;
+    MPCConfig conf;
+    VectorXd z_min, z_max;
+    ParseNew(sce_path, m_map, cvd, mvd, conf, z_min, z_max);
+
+    // Nonzero actuation levels, the settled input must be charged at S(N) by both engines
+    const int n_MV = m_map[kN_MV];
+    std::vector<double> u_init = mvd.Inits;
+    for (int j = 0; j < n_MV; j++) {
+        u_init[j] += 100.0 * (j + 1);
+    }
+    FSRModel fsr(cvd.getSR(), m_map, conf, u_init, cvd.getInits());
+    FSRModel ss = fsr.fork();
+    const auto realization = RealizeERA(*cvd.getSR(), order);
+    ss.setStateSpace(realization);
+    std::cout << realization->Report() << std::endl;
+
+    // Both engines take the same moves, the free responses are compared before every step
+    double deviation = 0, scale = 1;
+    for (int k = 0; k <= steps; k++) {
+        deviation = std::max(deviation, (ss.getLambda() - fsr.getLambda()).cwiseAbs().maxCoeff());
+        scale = std::max(scale, fsr.getLambda().cwiseAbs().maxCoeff());
+        VectorXd du(n_MV);
+        for (int j = 0; j < n_MV; j++) {
+            du(j) = std::sin(0.7 * k + j);
+        }
+        fsr.UpdateU(du);
+        ss.UpdateU(du);
+    }
+    std::cout << "Lambda max deviation over " << steps << " steps: " << deviation << " (relative " << deviation / scale << ")" << std::endl;
+}
@@ -51,46 +51,33 @@ static MatrixXd ParseReferenceStr(string ref_str, int T, int P) {
     return ref;
 }
 
-string simulate(string sce_file, string sys_file, string sce, string ref_str, int T) {
-    // System variables:
-    CVData cvd; 
-    MVData mvd;
-    std::map<string, int> m_map;
-
-    // Scenario variables:
-    VectorXd z_min, z_max; /** Constraint vectors */
-    MPCConfig conf; /** MPC configuration */
-
-    // Parse information:
-    try {
-        Parse(sce_file, sys_file, m_map, cvd, mvd, conf, z_min, z_max);
-    } catch(std::out_of_range& e) {
-        return string(e.what());
-    } catch(std::invalid_argument& e) {
-        return string(e.what());
-    } catch(json::exception& e) {
-        return string(e.what());
-    } catch(...) {
-        return "ERROR: Parsing";
-    }
-
-    // Determine simulation type:
-    MPC_FSRM_Simulation sim_type;
-    bool reduced_cost = (conf.W != 0); // Simulate smaller QP
-    if (reduced_cost && conf.disable_slack) {
-        sim_type = MPC_FSRM_Simulation::CONDENSED_W_WoSlack;
-    } else if (conf.disable_slack) {
-        sim_type = MPC_FSRM_Simulation::CONDENSED_WoSlack;
-    } else if (reduced_cost) {
-        sim_type = MPC_FSRM_Simulation::CONDENSED_W;
-    } else {
-        sim_type = MPC_FSRM_Simulation::CONDENSED;
-    }
-
+/**
+ * @brief Simulate the MPC with an FSRModel of precision Scalar
+ * 
+ * @tparam Scalar precision of the FSRModel, see MPCConfig::single_precision
+ * @param sim_type simulation type
+ * @param sce scenario name
+ * @param ref_str reference data
+ * @param T MPC horizon
+ * @param cvd CVData
+ * @param mvd MVData
+ * @param conf MPC configuration
+ * @param m_map model parameters
+ * @param z_min lower constraint vector
+ * @param z_max upper constraint vector
+ * @return string simulation data in JSON format, or the error
+ */
+template <typename Scalar>
+static string SimulateFSRM(MPC_FSRM_Simulation sim_type, const string& sce, const string& ref_str, int T, const CVData& cvd, 
+                    const MVData& mvd, const MPCConfig& conf, std::map<string, int>& m_map, const VectorXd& z_min, const VectorXd& z_max) {
+    const auto SR = ToPrecision<Scalar>(cvd.getSR()); // Shared by every model of the simulation
+    // Optional state space realization computing the free response, realized once in double from the parsed step responses
+    const auto ss = conf.ss_order > 0 ? RealizeERA(*cvd.getSR(), conf.ss_order) : nullptr;
     string sim_results;
     switch (sim_type) {
         case MPC_FSRM_Simulation::CONDENSED: {
-            FSRModel fsr(cvd.getSR(), m_map, conf, mvd.Inits, cvd.getInits());
+            FSRModelT<Scalar> fsr(SR, m_map, conf, mvd.Inits, cvd.getInits());
+            fsr.setStateSpace(ss);
             
             // MPC variables:
             MatrixXd u_mat, y_pred, ref = ParseReferenceStr(ref_str, T, conf.P);
@@ -111,8 +98,10 @@ string simulate(string sce_file, string sys_file, string sce, string ref_str, in
         case MPC_FSRM_Simulation::CONDENSED_W: {
             MPCConfig sim_conf = conf;
             sim_conf.W = 0;
-            FSRModel fsr_sim(cvd.getSR(), m_map, sim_conf, mvd.Inits, cvd.getInits());
-            FSRModel fsr_cost(cvd.getSR(), m_map, conf, mvd.Inits, cvd.getInits());
+            FSRModelT<Scalar> fsr_sim(SR, m_map, sim_conf, mvd.Inits, cvd.getInits());
+            fsr_sim.setStateSpace(ss);
+            FSRModelT<Scalar> fsr_cost(SR, m_map, conf, mvd.Inits, cvd.getInits());
+            fsr_cost.setStateSpace(ss);
 
             // MPC variables:
             MatrixXd u_mat, y_pred, ref = ParseReferenceStr(ref_str, T, conf.P);
@@ -132,7 +121,8 @@ string simulate(string sce_file, string sys_file, string sce, string ref_str, in
         }
 
         case MPC_FSRM_Simulation::CONDENSED_WoSlack: {
-            FSRModel fsr(cvd.getSR(), m_map, conf, mvd.Inits, cvd.getInits());
+            FSRModelT<Scalar> fsr(SR, m_map, conf, mvd.Inits, cvd.getInits());
+            fsr.setStateSpace(ss);
             
             // MPC variables:
             MatrixXd u_mat, y_pred, ref = ParseReferenceStr(ref_str, T, conf.P);
@@ -153,8 +143,10 @@ string simulate(string sce_file, string sys_file, string sce, string ref_str, in
         case MPC_FSRM_Simulation::CONDENSED_W_WoSlack: {
             MPCConfig sim_conf = conf;
             sim_conf.W = 0;
-            FSRModel fsr_sim(cvd.getSR(), m_map, sim_conf, mvd.Inits, cvd.getInits());
-            FSRModel fsr_cost(cvd.getSR(), m_map, conf, mvd.Inits, cvd.getInits());
+            FSRModelT<Scalar> fsr_sim(SR, m_map, sim_conf, mvd.Inits, cvd.getInits());
+            fsr_sim.setStateSpace(ss);
+            FSRModelT<Scalar> fsr_cost(SR, m_map, conf, mvd.Inits, cvd.getInits());
+            fsr_cost.setStateSpace(ss);
 
             // MPC variables:
             MatrixXd u_mat, y_pred, ref = ParseReferenceStr(ref_str, T, conf.P);
@@ -173,4 +165,46 @@ string simulate(string sce_file, string sys_file, string sce, string ref_str, in
         }
     }
     return sim_results;
+}
+
+string simulate(string sce_file, string sys_file, string sce, string ref_str, int T) {
+    // System variables:
+    CVData cvd; 
+    MVData mvd;
+    std::map<string, int> m_map;
+
+    // Scenario variables:
+    VectorXd z_min, z_max; /** Constraint vectors */
+    MPCConfig conf; /** MPC configuration */
+
+    // Parse information:
+    try {
+        Parse(sce_file, sys_file, m_map, cvd, mvd, conf, z_min, z_max);
+    } catch(std::out_of_range& e) {
+        return string(e.what());
+    } catch(std::invalid_argument& e) {
+        return string(e.what());
+    } catch(json::exception& e) {
+        return string(e.what());
+    } catch(...) {
+        return "ERROR: Parsing";
+    }
+
+    // Determine simulation type:
+    MPC_FSRM_Simulation sim_type;
+    bool reduced_cost = (conf.W != 0); // Simulate smaller QP
+    if (reduced_cost && conf.disable_slack) {
+        sim_type = MPC_FSRM_Simulation::CONDENSED_W_WoSlack;
+    } else if (conf.disable_slack) {
+        sim_type = MPC_FSRM_Simulation::CONDENSED_WoSlack;
+    } else if (reduced_cost) {
+        sim_type = MPC_FSRM_Simulation::CONDENSED_W;
+    } else {
+        sim_type = MPC_FSRM_Simulation::CONDENSED;
+    }
+
+    if (conf.single_precision) {
+        return SimulateFSRM<float>(sim_type, sce, ref_str, T, cvd, mvd, conf, m_map, z_min, z_max);
+    }
+    return SimulateFSRM<double>(sim_type, sce, ref_str, T, cvd, mvd, conf, m_map, z_min, z_max);
 }
\ No newline at end of file